@@ -0,0 +1,257 @@
+#include "Assets.h"
+#include <QGLWidget>
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <QStringList>
+#include <QMutexLocker>
+#include <QDebug>
+
+// Editors often write a file in several steps, so wait
+// for them to settle before reloading
+static const int ASSETS_RELOAD_DELAY = 200;
+
+AssetLoader::AssetLoader() :
+    m_quit( false )
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+    stop();
+}
+
+void AssetLoader::request( const QString &name, const QString &path )
+{
+    QMutexLocker locker( &m_mutex );
+
+    for ( size_t i = 0; i < m_pending.size(); ++i ) {
+        if ( m_pending[i].first == name ) {
+            m_pending[i].second = path;
+            return;
+        }
+    }
+
+    m_pending.push_back( std::make_pair( name, path ) );
+    m_wake.wakeOne();
+}
+
+void AssetLoader::takeFinished( std::vector<LoadedAsset> &assets )
+{
+    QMutexLocker locker( &m_mutex );
+
+    assets.insert( assets.end(), m_finished.begin(), m_finished.end() );
+    m_finished.clear();
+}
+
+void AssetLoader::stop()
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        m_quit = true;
+        m_wake.wakeOne();
+    }
+
+    wait();
+}
+
+void AssetLoader::run()
+{
+    for ( ;; ) {
+        std::pair<QString, QString> job;
+        {
+            QMutexLocker locker( &m_mutex );
+            while ( !m_quit && m_pending.empty() ) {
+                m_wake.wait( &m_mutex );
+            }
+
+            if ( m_quit )
+                return;
+
+            job = m_pending.front();
+            m_pending.pop_front();
+        }
+
+        LoadedAsset asset;
+        if ( !Assets::load( job.first, job.second, asset ) ) {
+            qWarning() << "Failed to reload" << job.second;
+            continue;
+        }
+
+        QMutexLocker locker( &m_mutex );
+        m_finished.push_back( asset );
+    }
+}
+
+Assets::Assets( QObject *parent ) :
+    QObject( parent )
+{
+    QByteArray root = qgetenv( "CHRISTMASTREE_ASSETS" );
+    if ( root.isEmpty() ) {
+        m_root = QCoreApplication::applicationDirPath() + "/assets";
+    } else {
+        m_root = QDir( QString::fromLocal8Bit( root ) ).absolutePath();
+    }
+
+    m_reloadTimer.setSingleShot( true );
+    m_reloadTimer.setInterval( ASSETS_RELOAD_DELAY );
+
+    connect( &m_watcher, SIGNAL( fileChanged( QString ) ),
+             this, SLOT( slotFileChanged( QString ) ) );
+    connect( &m_watcher, SIGNAL( directoryChanged( QString ) ),
+             this, SLOT( slotDirectoryChanged( QString ) ) );
+    connect( &m_reloadTimer, SIGNAL( timeout() ),
+             this, SLOT( slotReload() ) );
+
+    m_loader.start( QThread::LowPriority );
+}
+
+Assets::~Assets()
+{
+    m_loader.stop();
+}
+
+void Assets::watch( const QString &name )
+{
+    m_sources[name] = path( name );
+    updateWatches();
+}
+
+QString Assets::path( const QString &name ) const
+{
+    QString disk = m_root + "/" + name;
+    if ( QFileInfo( disk ).isFile() )
+        return disk;
+
+    return ":/" + name;
+}
+
+///////////////////////////////////////////////////////
+// Scene files are text with one "tree x y z" per line,
+// and an optional "forest n" that scatters n more trees
+// over the terrain; blank lines and lines starting with
+// # are skipped. A file with a bad line or no trees is
+// rejected, so a half-saved edit keeps the last scene.
+// Anything else is decoded as an image.
+bool Assets::load( const QString &name, const QString &path, LoadedAsset &asset )
+{
+    asset.name = name;
+
+    if ( name.endsWith( ".txt" ) ) {
+        QFile file( path );
+        if ( !file.open( QIODevice::ReadOnly | QIODevice::Text ) )
+            return false;
+
+        QTextStream in( &file );
+        while ( !in.atEnd() ) {
+            QString line = in.readLine().simplified();
+            if ( line.isEmpty() || line.startsWith( '#' ) )
+                continue;
+
+            QStringList fields = line.split( ' ' );
+            if ( fields.size() == 2 && fields[0] == "forest" ) {
+                bool ok;
+                int count = fields[1].toInt( &ok );
+                if ( ok && count >= 0 ) {
+                    asset.forest = count;
+                    continue;
+                }
+            }
+
+            bool ok = ( fields.size() == 4 && fields[0] == "tree" );
+            float location[3];
+            for ( int i = 0; ok && i < 3; ++i ) {
+                location[i] = fields[i + 1].toFloat( &ok );
+            }
+
+            if ( !ok ) {
+                qWarning() << "Bad line in" << path << ":" << line;
+                return false;
+            }
+
+            asset.trees.insert( asset.trees.end(), location, location + 3 );
+        }
+
+        if ( asset.trees.empty() && asset.forest == 0 ) {
+            qWarning() << "No trees in" << path;
+            return false;
+        }
+        return true;
+    }
+
+    QImage image;
+    if ( !image.load( path ) )
+        return false;
+
+    asset.image = QGLWidget::convertToGLFormat( image );
+    return true;
+}
+
+void Assets::takeLoaded( std::vector<LoadedAsset> &assets )
+{
+    m_loader.takeFinished( assets );
+}
+
+void Assets::slotFileChanged( const QString &path )
+{
+    for ( QMap<QString, QString>::const_iterator it = m_sources.constBegin();
+          it != m_sources.constEnd(); ++it ) {
+        if ( m_root + "/" + it.key() == path ) {
+            m_changed.insert( it.key() );
+            m_reloadTimer.start();
+        }
+    }
+}
+
+// A file was added to or removed from a watched directory,
+// so an asset may now come from disk instead of the bundle
+// or the other way round
+void Assets::slotDirectoryChanged( const QString & )
+{
+    for ( QMap<QString, QString>::const_iterator it = m_sources.constBegin();
+          it != m_sources.constEnd(); ++it ) {
+        if ( path( it.key() ) != it.value() ) {
+            m_changed.insert( it.key() );
+            m_reloadTimer.start();
+        }
+    }
+}
+
+void Assets::slotReload()
+{
+    foreach ( const QString &name, m_changed ) {
+        QString source = path( name );
+        m_sources[name] = source;
+        m_loader.request( name, source );
+    }
+    m_changed.clear();
+
+    // Files replaced by a rename are dropped from the watcher
+    updateWatches();
+}
+
+void Assets::updateWatches()
+{
+    QStringList paths;
+    if ( QFileInfo( m_root ).isDir() )
+        paths << m_root;
+
+    for ( QMap<QString, QString>::const_iterator it = m_sources.constBegin();
+          it != m_sources.constEnd(); ++it ) {
+        QFileInfo disk( m_root + "/" + it.key() );
+        if ( QFileInfo( disk.absolutePath() ).isDir() )
+            paths << disk.absolutePath();
+        if ( disk.isFile() )
+            paths << disk.filePath();
+    }
+
+    QStringList watched = m_watcher.files() + m_watcher.directories();
+    foreach ( const QString &path, paths ) {
+        if ( !watched.contains( path ) ) {
+            m_watcher.addPath( path );
+            watched << path;
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <vector>
+#include <deque>
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QImage>
+#include <QString>
+#include <QMap>
+#include <QSet>
+
+struct LoadedAsset
+{
+    LoadedAsset() : forest( 0 ) {}
+
+    QString name;                   // Path under the asset root, e.g. "textures/Snow.jpg"
+    QImage image;                   // Texture already in GL format
+    std::vector<float> trees;       // x, y, z of every tree in a scene file
+    int forest;                     // Trees to scatter around them
+};
+
+///////////////////////////////////////////////////////
+// Background thread that decodes images and parses
+// scene files, so that paintGL only has to upload them
+class AssetLoader : public QThread
+{
+public:
+    AssetLoader();
+    ~AssetLoader();
+
+    void request( const QString &name, const QString &path );
+
+    // Move the loaded assets into assets, never blocks on decoding
+    void takeFinished( std::vector<LoadedAsset> &assets );
+
+    void stop();
+
+protected:
+    void run();
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::deque< std::pair<QString, QString> > m_pending;
+    std::vector<LoadedAsset> m_finished;
+    bool m_quit;
+};
+
+///////////////////////////////////////////////////////
+// Textures and scene data are read from an asset
+// directory on disk when a file exists there, and from
+// the Textures.qrc bundle otherwise. Files on disk are
+// watched and reloaded on the loader thread when they
+// change. The directory is $CHRISTMASTREE_ASSETS, or
+// "assets" next to the executable.
+class Assets : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Assets( QObject *parent = 0 );
+    ~Assets();
+
+    // Register an asset and watch its file on disk
+    void watch( const QString &name );
+
+    // Disk path if the file exists there, resource path otherwise
+    QString path( const QString &name ) const;
+
+    // Decode an asset, safe to call from any thread
+    static bool load( const QString &name, const QString &path, LoadedAsset &asset );
+
+    // Move reloaded assets into assets, never blocks
+    void takeLoaded( std::vector<LoadedAsset> &assets );
+
+private slots:
+    void slotFileChanged( const QString &path );
+    void slotDirectoryChanged( const QString &path );
+    void slotReload();
+
+private:
+    void updateWatches();
+
+private:
+    QString m_root;
+    QMap<QString, QString> m_sources;   // Asset name to the path it was last loaded from
+    QSet<QString> m_changed;
+    QFileSystemWatcher m_watcher;
+    QTimer m_reloadTimer;
+    AssetLoader m_loader;
+};
+
+#endif // ASSETS_H
@@ -14,12 +14,29 @@ TEMPLATE = app
 
 SOURCES += main.cpp\
         Dialog.cpp \
-    Scene.cpp
+    Scene.cpp \
+    Snow.cpp \
+    Terrain.cpp \
+    Profiler.cpp \
+    Assets.cpp \
+    FrameCapture.cpp \
+    World.cpp \
+    OcclusionCuller.cpp \
+    Replay.cpp
 
 HEADERS  += Dialog.h \
     Scene.h \
     Ground.h \
-    Cube.h
+    Cube.h \
+    Snow.h \
+    Terrain.h \
+    Profiler.h \
+    Assets.h \
+    FrameCapture.h \
+    World.h \
+    Tree.h \
+    OcclusionCuller.h \
+    Replay.h
 
 FORMS    += Dialog.ui
 
@@ -1,5 +1,6 @@
 #include "Dialog.h"
 #include "ui_Dialog.h"
+#include "Scene.h"
 
 Dialog::Dialog(QWidget *parent) :
     QDialog(parent),
@@ -12,3 +13,17 @@ Dialog::~Dialog()
 {
     delete ui;
 }
+
+void Dialog::setViewCount(int count)
+{
+    for (int i = ui->horizontalLayout->count(); i < count; ++i) {
+        Scene *view = new Scene(this, ui->widget);
+        view->setCameraOrbit(360.0f * i / count);
+        ui->horizontalLayout->addWidget(view);
+    }
+}
+
+World &Dialog::world()
+{
+    return ui->widget->world();
+}
@@ -7,6 +7,8 @@ namespace Ui {
     class Dialog;
 }
 
+class World;
+
 class Dialog : public QDialog
 {
     Q_OBJECT
@@ -15,6 +17,13 @@ public:
     explicit Dialog(QWidget *parent = 0);
     ~Dialog();
 
+    // Add views next to the first one until there are count,
+    // each orbiting the field at its own angle
+    void setViewCount(int count);
+
+    // The world all the views show
+    World &world();
+
 private:
     Ui::Dialog *ui;
 };
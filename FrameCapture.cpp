@@ -0,0 +1,399 @@
+#include "FrameCapture.h"
+#include <QGLContext>
+#include <QImage>
+#include <QDir>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QDebug>
+#include <string.h>
+
+///////////////////////////////////////////////////////
+// OpenGL 1.5 pixel buffer tokens missing from some gl.h
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_READ_ONLY
+#define GL_READ_ONLY 0x88B8
+#endif
+
+// Frames waiting for the encoder before new ones are dropped
+static const int CAPTURE_POOL_FRAMES = 8;
+
+// PNG quality 100 is no compression; this keeps files small
+// while staying fast enough for sustained capture
+static const int CAPTURE_PNG_QUALITY = 80;
+
+FrameEncoder::FrameEncoder() :
+    m_format( ImageSequence ),
+    m_width( 0 ),
+    m_height( 0 ),
+    m_sourceWidth( 0 ),
+    m_sourceHeight( 0 ),
+    m_written( 0 ),
+    m_quit( false )
+{
+}
+
+FrameEncoder::~FrameEncoder()
+{
+    close();
+}
+
+bool FrameEncoder::open( const QString &directory, Format format,
+                         int width, int height, int poolSize )
+{
+    if ( !QDir().mkpath( directory ) ) {
+        qWarning() << "Cannot create" << directory;
+        return false;
+    }
+
+    // Never write over an earlier capture
+    QDir dir( directory );
+    if ( dir.exists( "capture.yuv" ) || dir.exists( "frame000000.png" ) ) {
+        qWarning() << directory << "already holds a capture";
+        return false;
+    }
+
+    m_directory = directory;
+    m_format = format;
+    m_width = width;
+    m_height = height;
+    m_sourceWidth = width;
+    m_sourceHeight = height;
+    m_written = 0;
+    m_quit = false;
+
+    if ( format == RawYuv ) {
+        m_file.setFileName( QDir( directory ).filePath( "capture.yuv" ) );
+        if ( !m_file.open( QIODevice::WriteOnly ) ) {
+            qWarning() << "Cannot write" << m_file.fileName();
+            return false;
+        }
+
+        // I420 needs even dimensions, the odd row or column is dropped
+        m_width = width & ~1;
+        m_height = height & ~1;
+        m_yuv.resize( m_width * m_height * 3 / 2 );
+
+        if ( !writeYuvInfo() ) {
+            m_file.close();
+            return false;
+        }
+    }
+
+    m_pool.resize( poolSize );
+    m_free.clear();
+    m_queue.clear();
+    for ( int i = 0; i < poolSize; ++i ) {
+        m_pool[i].pixels.resize( width * height * 4 );
+        m_free.push_back( &m_pool[i] );
+    }
+
+    start( QThread::LowPriority );
+    return true;
+}
+
+// Write everything still queued and stop the thread
+void FrameEncoder::close()
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        m_quit = true;
+        m_wake.wakeOne();
+    }
+
+    wait();
+
+    if ( m_file.isOpen() )
+        m_file.close();
+}
+
+FrameEncoder::Frame *FrameEncoder::acquire()
+{
+    QMutexLocker locker( &m_mutex );
+
+    if ( m_free.empty() )
+        return 0;
+
+    Frame *frame = m_free.back();
+    m_free.pop_back();
+    return frame;
+}
+
+void FrameEncoder::submit( Frame *frame )
+{
+    QMutexLocker locker( &m_mutex );
+
+    m_queue.push_back( frame );
+    m_wake.wakeOne();
+}
+
+int FrameEncoder::framesWritten() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_written;
+}
+
+void FrameEncoder::run()
+{
+    for ( ;; ) {
+        Frame *frame = 0;
+        {
+            QMutexLocker locker( &m_mutex );
+            while ( !m_quit && m_queue.empty() ) {
+                m_wake.wait( &m_mutex );
+            }
+
+            if ( m_queue.empty() )
+                return;
+
+            frame = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        write( frame );
+
+        QMutexLocker locker( &m_mutex );
+        m_free.push_back( frame );
+        ++m_written;
+    }
+}
+
+void FrameEncoder::write( const Frame *frame )
+{
+    if ( m_format == RawYuv ) {
+        writeYuv( frame );
+        return;
+    }
+
+    // Rows come from OpenGL bottom first
+    QImage image( &frame->pixels[0], m_width, m_height, QImage::Format_RGB32 );
+    QString name = QString( "frame%1.png" ).arg( frame->number, 6, 10, QChar( '0' ) );
+    if ( !image.mirrored().save( QDir( m_directory ).filePath( name ), "PNG",
+                                 CAPTURE_PNG_QUALITY ) ) {
+        qWarning() << "Cannot write" << name;
+    }
+}
+
+///////////////////////////////////////////////////////
+// BGRA to I420 with BT.601 studio range coefficients.
+// Chroma is the average of each 2x2 block.
+void FrameEncoder::writeYuv( const Frame *frame )
+{
+    const int srcStride = m_sourceWidth * 4;
+
+    unsigned char *yPlane = &m_yuv[0];
+    unsigned char *uPlane = yPlane + m_width * m_height;
+    unsigned char *vPlane = uPlane + m_width * m_height / 4;
+
+    for ( int y = 0; y < m_height; y += 2 ) {
+        // Flip vertically while converting
+        const unsigned char *row0 = &frame->pixels[0] + ( m_sourceHeight - 1 - y ) * srcStride;
+        const unsigned char *row1 = row0 - srcStride;
+        unsigned char *y0 = yPlane + y * m_width;
+        unsigned char *y1 = y0 + m_width;
+
+        for ( int x = 0; x < m_width; x += 2 ) {
+            int r = 0, g = 0, b = 0;
+            const unsigned char *pixels[4] = { row0 + x * 4, row0 + x * 4 + 4,
+                                               row1 + x * 4, row1 + x * 4 + 4 };
+            unsigned char *luma[4] = { y0 + x, y0 + x + 1, y1 + x, y1 + x + 1 };
+
+            for ( int i = 0; i < 4; ++i ) {
+                int pb = pixels[i][0];
+                int pg = pixels[i][1];
+                int pr = pixels[i][2];
+                *luma[i] = ( unsigned char ) ( ( ( 66 * pr + 129 * pg + 25 * pb + 128 ) >> 8 ) + 16 );
+                r += pr;
+                g += pg;
+                b += pb;
+            }
+
+            r /= 4;
+            g /= 4;
+            b /= 4;
+            int chroma = ( y / 2 ) * ( m_width / 2 ) + x / 2;
+            uPlane[chroma] = ( unsigned char ) ( ( ( -38 * r - 74 * g + 112 * b + 128 ) >> 8 ) + 128 );
+            vPlane[chroma] = ( unsigned char ) ( ( ( 112 * r - 94 * g - 18 * b + 128 ) >> 8 ) + 128 );
+        }
+    }
+
+    if ( m_file.write( ( const char * ) &m_yuv[0], m_yuv.size() ) != ( qint64 ) m_yuv.size() )
+        qWarning() << "Cannot write" << m_file.fileName();
+}
+
+///////////////////////////////////////////////////////
+// The raw stream has no header, so its size and layout
+// go into capture.txt, with a command line that plays it
+bool FrameEncoder::writeYuvInfo() const
+{
+    QFile info( QDir( m_directory ).filePath( "capture.txt" ) );
+    if ( !info.open( QIODevice::WriteOnly | QIODevice::Text ) ) {
+        qWarning() << "Cannot write" << info.fileName();
+        return false;
+    }
+
+    QTextStream out( &info );
+    out << "file capture.yuv\n"
+        << "format I420 (yuv420p), BT.601 studio range, no header\n"
+        << "width " << m_width << "\n"
+        << "height " << m_height << "\n"
+        << "# ffplay -f rawvideo -pixel_format yuv420p -video_size "
+        << m_width << "x" << m_height << " capture.yuv\n";
+    return true;
+}
+
+FrameCapture::FrameCapture() :
+    m_mapBuffer( 0 ),
+    m_unmapBuffer( 0 ),
+    m_usePbo( false ),
+    m_active( false ),
+    m_width( 0 ),
+    m_height( 0 ),
+    m_frame( 0 ),
+    m_captured( 0 ),
+    m_dropped( 0 )
+{
+    m_pbo[0] = 0;
+    m_pbo[1] = 0;
+}
+
+FrameCapture::~FrameCapture()
+{
+    m_encoder.close();
+}
+
+bool FrameCapture::begin( const QString &directory, FrameEncoder::Format format,
+                          int width, int height )
+{
+    if ( m_active )
+        end();
+
+    if ( !m_encoder.open( directory, format, width, height, CAPTURE_POOL_FRAMES ) )
+        return false;
+
+    const QGLContext *context = QGLContext::currentContext();
+    m_gl.initializeGLFunctions( context );
+    m_mapBuffer = ( MapBufferFunc ) context->getProcAddress( "glMapBuffer" );
+    m_unmapBuffer = ( UnmapBufferFunc ) context->getProcAddress( "glUnmapBuffer" );
+    m_usePbo = m_gl.hasOpenGLFeature( QGLFunctions::Buffers ) &&
+            m_mapBuffer && m_unmapBuffer;
+
+    m_width = width;
+    m_height = height;
+    m_frame = 0;
+    m_captured = 0;
+    m_dropped = 0;
+
+    if ( m_usePbo ) {
+        m_gl.glGenBuffers( 2, m_pbo );
+        for ( int i = 0; i < 2; ++i ) {
+            m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, m_pbo[i] );
+            m_gl.glBufferData( GL_PIXEL_PACK_BUFFER, width * height * 4, 0, GL_STREAM_READ );
+        }
+        m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    } else {
+        qDebug() << "Pixel buffer objects not supported, capture will stall the pipeline";
+    }
+
+    qDebug() << "Capturing" << m_encoder.width() << "x" << m_encoder.height()
+             << ( format == FrameEncoder::RawYuv ? "I420" : "PNG" ) << "to" << directory;
+
+    m_timer.start();
+    m_active = true;
+    return true;
+}
+
+void FrameCapture::end()
+{
+    if ( !m_active )
+        return;
+
+    // The last frame read is still waiting in its buffer
+    if ( m_usePbo && m_frame > 0 ) {
+        m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, m_pbo[( m_frame - 1 ) % 2] );
+        const void *pixels = m_mapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+        if ( pixels ) {
+            copyFrame( pixels );
+            m_unmapBuffer( GL_PIXEL_PACK_BUFFER );
+        } else {
+            ++m_dropped;
+        }
+        m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    }
+
+    if ( m_usePbo ) {
+        m_gl.glDeleteBuffers( 2, m_pbo );
+        m_pbo[0] = 0;
+        m_pbo[1] = 0;
+    }
+
+    m_encoder.close();
+
+    double seconds = m_timer.elapsed() / 1000.0;
+    qDebug() << "Capture finished:" << m_encoder.framesWritten() << "frames written,"
+             << m_dropped << "dropped,"
+             << ( seconds > 0.0 ? m_encoder.framesWritten() / seconds : 0.0 ) << "frames/sec";
+
+    m_active = false;
+}
+
+void FrameCapture::capture()
+{
+    if ( !m_active )
+        return;
+
+    glPixelStorei( GL_PACK_ALIGNMENT, 4 );
+
+    if ( !m_usePbo ) {
+        FrameEncoder::Frame *frame = m_encoder.acquire();
+        if ( !frame ) {
+            ++m_dropped;
+        } else {
+            glReadPixels( 0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_BYTE,
+                          &frame->pixels[0] );
+            frame->number = m_captured++;
+            m_encoder.submit( frame );
+        }
+        ++m_frame;
+        return;
+    }
+
+    // Start reading this frame into one buffer...
+    m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, m_pbo[m_frame % 2] );
+    glReadPixels( 0, 0, m_width, m_height, GL_BGRA, GL_UNSIGNED_BYTE, 0 );
+
+    // ...and collect the previous one, which has had a frame to arrive
+    if ( m_frame > 0 ) {
+        m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, m_pbo[( m_frame - 1 ) % 2] );
+        const void *pixels = m_mapBuffer( GL_PIXEL_PACK_BUFFER, GL_READ_ONLY );
+        if ( pixels ) {
+            copyFrame( pixels );
+            m_unmapBuffer( GL_PIXEL_PACK_BUFFER );
+        } else {
+            ++m_dropped;
+        }
+    }
+
+    m_gl.glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+    ++m_frame;
+}
+
+void FrameCapture::copyFrame( const void *pixels )
+{
+    FrameEncoder::Frame *frame = m_encoder.acquire();
+    if ( !frame ) {
+        ++m_dropped;
+        return;
+    }
+
+    memcpy( &frame->pixels[0], pixels, frame->pixels.size() );
+    frame->number = m_captured++;
+    m_encoder.submit( frame );
+}
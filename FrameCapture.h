@@ -0,0 +1,124 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <vector>
+#include <deque>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QString>
+#include <QFile>
+#include <QGLFunctions>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+///////////////////////////////////////////////////////
+// Thread that writes captured frames to disk, either as
+// numbered PNG files or as one raw I420 (YUV 4:2:0)
+// stream with its size in a capture.txt next to it. Frames come from a fixed pool, so a slow disk
+// makes the capture drop frames instead of using memory.
+class FrameEncoder : public QThread
+{
+public:
+    enum Format { ImageSequence, RawYuv };
+
+    struct Frame
+    {
+        std::vector<unsigned char> pixels;  // BGRA, bottom row first
+        int number;
+    };
+
+    FrameEncoder();
+    ~FrameEncoder();
+
+    bool open( const QString &directory, Format format,
+               int width, int height, int poolSize );
+    void close();
+
+    // A free frame to fill, or 0 if the encoder is behind
+    Frame *acquire();
+    void submit( Frame *frame );
+
+    int framesWritten() const;
+
+    // Size written to disk, RawYuv drops an odd row or column
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+protected:
+    void run();
+
+private:
+    void write( const Frame *frame );
+    void writeYuv( const Frame *frame );
+    bool writeYuvInfo() const;
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::vector<Frame> m_pool;
+    std::vector<Frame*> m_free;
+    std::deque<Frame*> m_queue;
+    std::vector<unsigned char> m_yuv;
+    QString m_directory;
+    QFile m_file;
+    Format m_format;
+    int m_width;                        // Size written to disk
+    int m_height;
+    int m_sourceWidth;                  // Size of the captured frames
+    int m_sourceHeight;
+    int m_written;
+    bool m_quit;
+};
+
+///////////////////////////////////////////////////////
+// Reads back each rendered frame through two pixel
+// buffer objects: the frame drawn now is read into one
+// while the previous frame is copied out of the other,
+// so glReadPixels never waits for the GPU. Falls back
+// to a plain glReadPixels without OpenGL 1.5.
+class FrameCapture
+{
+public:
+    FrameCapture();
+    ~FrameCapture();
+
+    bool isActive() const { return m_active; }
+
+    // Both need the GL context current
+    bool begin( const QString &directory, FrameEncoder::Format format,
+                int width, int height );
+    void end();
+
+    // Call after the frame is drawn, before the buffers swap
+    void capture();
+
+    int framesCaptured() const { return m_captured; }
+    int framesDropped() const { return m_dropped; }
+
+private:
+    void copyFrame( const void *pixels );
+
+private:
+    typedef void *( APIENTRY *MapBufferFunc )( GLenum target, GLenum access );
+    typedef GLboolean ( APIENTRY *UnmapBufferFunc )( GLenum target );
+
+    QGLFunctions m_gl;
+    MapBufferFunc m_mapBuffer;
+    UnmapBufferFunc m_unmapBuffer;
+    FrameEncoder m_encoder;
+    QElapsedTimer m_timer;
+    GLuint m_pbo[2];
+    bool m_usePbo;
+    bool m_active;
+    int m_width;
+    int m_height;
+    int m_frame;
+    int m_captured;
+    int m_dropped;
+};
+
+#endif // FRAMECAPTURE_H
@@ -7,6 +7,7 @@ class Ground
 {
 public:
     std::vector<float> vertices;
+    std::vector<float> normals;
     std::vector<float> textures;
     std::vector<unsigned int> indices;
 };
@@ -0,0 +1,174 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+OcclusionCuller::OcclusionCuller( int width, int height ) :
+    m_tanX( 1.0f ),
+    m_tanY( 1.0f ),
+    m_near( 1.0f )
+{
+    // Level 0 is padded to a multiple of four texels so that
+    // every level halves exactly and no texel is left out of a max
+    Level level;
+    level.width = ( width + 3 ) & ~3;
+    level.height = ( height + 3 ) & ~3;
+    level.depth.resize( level.width * level.height, FLT_MAX );
+    m_levels.push_back( level );
+
+    while ( level.width % 2 == 0 && level.height % 2 == 0 &&
+            level.width >= 8 && level.height >= 2 ) {
+        level.width /= 2;
+        level.height /= 2;
+        level.depth.assign( level.width * level.height, FLT_MAX );
+        m_levels.push_back( level );
+    }
+}
+
+void OcclusionCuller::begin( float tanHalfFovX, float tanHalfFovY, float nearZ )
+{
+    m_tanX = tanHalfFovX;
+    m_tanY = tanHalfFovY;
+    m_near = nearZ;
+
+    std::fill( m_levels[0].depth.begin(), m_levels[0].depth.end(), FLT_MAX );
+}
+
+///////////////////////////////////////////////////////
+// Draw the square inscribed in the sphere's central
+// cross-section at the depth of the sphere's far side.
+// Only pixels the square fully covers are written, so
+// the occluder never hides more than it really does.
+void OcclusionCuller::addOccluder( float x, float y, float z, float radius )
+{
+    if ( z - radius < m_near )
+        return;
+
+    Level &level = m_levels[0];
+    const float h = radius * 0.70710678f;
+    const float sx = 0.5f * level.width / ( z * m_tanX );
+    const float sy = 0.5f * level.height / ( z * m_tanY );
+
+    float left = ( x - h ) * sx + 0.5f * level.width;
+    float right = ( x + h ) * sx + 0.5f * level.width;
+    float top = 0.5f * level.height - ( y + h ) * sy;
+    float bottom = 0.5f * level.height - ( y - h ) * sy;
+
+    int x0 = std::max( 0, ( int ) ceilf( left ) );
+    int x1 = std::min( level.width, ( int ) floorf( right ) );
+    int y0 = std::max( 0, ( int ) ceilf( top ) );
+    int y1 = std::min( level.height, ( int ) floorf( bottom ) );
+
+    const float depth = z + radius;
+
+    for ( int row = y0; row < y1; ++row ) {
+        float *p = &level.depth[row * level.width];
+        int col = x0;
+
+#ifdef OCCLUSION_USE_SSE
+        const __m128 d = _mm_set1_ps( depth );
+        for ( ; col + 4 <= x1; col += 4 ) {
+            _mm_storeu_ps( p + col, _mm_min_ps( _mm_loadu_ps( p + col ), d ) );
+        }
+#endif
+
+        for ( ; col < x1; ++col ) {
+            p[col] = std::min( p[col], depth );
+        }
+    }
+}
+
+void OcclusionCuller::build()
+{
+    for ( size_t i = 1; i < m_levels.size(); ++i ) {
+        buildLevel( m_levels[i - 1], m_levels[i] );
+    }
+}
+
+// Each texel keeps the farthest of the 2x2 texels below it
+void OcclusionCuller::buildLevel( const Level &src, Level &dst )
+{
+    for ( int row = 0; row < dst.height; ++row ) {
+        const float *r0 = &src.depth[row * 2 * src.width];
+        const float *r1 = r0 + src.width;
+        float *out = &dst.depth[row * dst.width];
+        int col = 0;
+
+#ifdef OCCLUSION_USE_SSE
+        for ( ; col + 4 <= dst.width; col += 4 ) {
+            __m128 a = _mm_max_ps( _mm_loadu_ps( r0 + col * 2 ),
+                                   _mm_loadu_ps( r1 + col * 2 ) );
+            __m128 b = _mm_max_ps( _mm_loadu_ps( r0 + col * 2 + 4 ),
+                                   _mm_loadu_ps( r1 + col * 2 + 4 ) );
+            __m128 even = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+            __m128 odd = _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+            _mm_storeu_ps( out + col, _mm_max_ps( even, odd ) );
+        }
+#endif
+
+        for ( ; col < dst.width; ++col ) {
+            out[col] = std::max( std::max( r0[col * 2], r0[col * 2 + 1] ),
+                                 std::max( r1[col * 2], r1[col * 2 + 1] ) );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////
+// Bound the sphere on screen, pick the pyramid level at
+// which that rectangle spans at most 4x4 texels, and
+// report it hidden only if every texel holds an occluder
+// nearer than the sphere's nearest point.
+bool OcclusionCuller::isVisible( float x, float y, float z, float radius ) const
+{
+    const float zNear = z - radius;
+    if ( zNear < m_near )
+        return true;
+
+    const Level &base = m_levels[0];
+    const float zFar = z + radius;
+
+    // Extremes of the sphere's bounding box corners
+    float ndcX[4] = { ( x - radius ) / zNear, ( x - radius ) / zFar,
+                      ( x + radius ) / zNear, ( x + radius ) / zFar };
+    float ndcY[4] = { ( y - radius ) / zNear, ( y - radius ) / zFar,
+                      ( y + radius ) / zNear, ( y + radius ) / zFar };
+    float minX = *std::min_element( ndcX, ndcX + 4 ) / m_tanX;
+    float maxX = *std::max_element( ndcX, ndcX + 4 ) / m_tanX;
+    float minY = *std::min_element( ndcY, ndcY + 4 ) / m_tanY;
+    float maxY = *std::max_element( ndcY, ndcY + 4 ) / m_tanY;
+
+    float left = ( minX * 0.5f + 0.5f ) * base.width;
+    float right = ( maxX * 0.5f + 0.5f ) * base.width;
+    float top = ( 0.5f - maxY * 0.5f ) * base.height;
+    float bottom = ( 0.5f - minY * 0.5f ) * base.height;
+
+    if ( right < 0.0f || left >= base.width || bottom < 0.0f || top >= base.height )
+        return true;
+
+    int x0 = std::max( 0, ( int ) floorf( left ) );
+    int x1 = std::min( base.width - 1, ( int ) floorf( right ) );
+    int y0 = std::max( 0, ( int ) floorf( top ) );
+    int y1 = std::min( base.height - 1, ( int ) floorf( bottom ) );
+
+    size_t l = 0;
+    while ( l + 1 < m_levels.size() &&
+            ( ( x1 >> l ) - ( x0 >> l ) >= 4 || ( y1 >> l ) - ( y0 >> l ) >= 4 ) ) {
+        ++l;
+    }
+
+    const Level &level = m_levels[l];
+    for ( int row = y0 >> l; row <= ( y1 >> l ); ++row ) {
+        const float *p = &level.depth[row * level.width];
+        for ( int col = x0 >> l; col <= ( x1 >> l ); ++col ) {
+            if ( p[col] > zNear )
+                return true;
+        }
+    }
+
+    return false;
+}
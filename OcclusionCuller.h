@@ -0,0 +1,50 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+#include <vector>
+
+///////////////////////////////////////////////////////
+// Software occlusion culling. The nearest objects are
+// drawn into a small depth buffer on the CPU as
+// rectangles they are sure to cover, a max-depth
+// (hierarchical Z) pyramid is built from it, and each
+// object's bounding sphere is tested against the level
+// where it covers only a few texels. Everything is in
+// view space: x right, y up, z distance from the eye.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller( int width = 256, int height = 128 );
+
+    // Start a frame with the half field of view tangents
+    void begin( float tanHalfFovX, float tanHalfFovY, float nearZ );
+
+    // A sphere that lies completely inside a solid occluder
+    void addOccluder( float x, float y, float z, float radius );
+
+    // Build the pyramid, call after the last occluder
+    void build();
+
+    // False only if the sphere is certainly hidden
+    bool isVisible( float x, float y, float z, float radius ) const;
+
+    int levels() const { return ( int ) m_levels.size(); }
+
+private:
+    struct Level
+    {
+        int width;
+        int height;
+        std::vector<float> depth;       // Farthest occluder depth per texel
+    };
+
+    void buildLevel( const Level &src, Level &dst );
+
+private:
+    std::vector<Level> m_levels;
+    float m_tanX;
+    float m_tanY;
+    float m_near;
+};
+
+#endif // OCCLUSIONCULLER_H
@@ -0,0 +1,88 @@
+#include "Profiler.h"
+#include <QDebug>
+#include <QString>
+
+Profiler::Profiler() :
+    m_frameTotalNs( 0 ),
+    m_frames( 0 ),
+    m_reportInterval( 300 ),
+    m_enabled( false )
+{
+}
+
+void Profiler::beginFrame()
+{
+    m_frameTimer.start();
+}
+
+void Profiler::endFrame()
+{
+    m_frameTotalNs += m_frameTimer.nsecsElapsed();
+    ++m_frames;
+
+    if ( m_frames >= m_reportInterval ) {
+        report();
+    }
+}
+
+void Profiler::begin( const char *section )
+{
+    m_sections[section].timer.start();
+}
+
+void Profiler::end( const char *section )
+{
+    Section &s = m_sections[section];
+    if ( s.timer.isValid() )
+        s.totalNs += s.timer.nsecsElapsed();
+}
+
+void Profiler::count( const char *counter, int value )
+{
+    m_counters[counter].total += value;
+}
+
+double Profiler::averageMs( const char *section ) const
+{
+    std::map<std::string, Section>::const_iterator it = m_sections.find( section );
+    return ( it == m_sections.end() ) ? 0.0 : it->second.lastAverageMs;
+}
+
+double Profiler::averageCount( const char *counter ) const
+{
+    std::map<std::string, Counter>::const_iterator it = m_counters.find( counter );
+    return ( it == m_counters.end() ) ? 0.0 : it->second.lastAverage;
+}
+
+///////////////////////////////////////////////////////
+// Turn the totals into per-frame averages, print them
+// if enabled and start a new interval
+void Profiler::report()
+{
+    QString line = QString( "frame %1 ms" )
+            .arg( m_frameTotalNs / 1.0e6 / m_frames, 0, 'f', 2 );
+
+    for ( std::map<std::string, Section>::iterator it = m_sections.begin();
+          it != m_sections.end(); ++it ) {
+        it->second.lastAverageMs = it->second.totalNs / 1.0e6 / m_frames;
+        it->second.totalNs = 0;
+        line += QString( " | %1 %2 ms" )
+                .arg( QString::fromStdString( it->first ) )
+                .arg( it->second.lastAverageMs, 0, 'f', 2 );
+    }
+
+    for ( std::map<std::string, Counter>::iterator it = m_counters.begin();
+          it != m_counters.end(); ++it ) {
+        it->second.lastAverage = ( double ) it->second.total / m_frames;
+        it->second.total = 0;
+        line += QString( " | %1 %2" )
+                .arg( QString::fromStdString( it->first ) )
+                .arg( it->second.lastAverage, 0, 'f', 1 );
+    }
+
+    if ( m_enabled )
+        qDebug() << qPrintable( line );
+
+    m_frameTotalNs = 0;
+    m_frames = 0;
+}
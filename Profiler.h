@@ -0,0 +1,65 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <map>
+#include <string>
+#include <QElapsedTimer>
+
+///////////////////////////////////////////////////////
+// Per-frame timings and counters. Named sections are
+// timed between begin() and end(), counters are summed
+// with count(), and averages over the last interval are
+// printed with qDebug() when reporting is enabled.
+class Profiler
+{
+public:
+    Profiler();
+
+    void setEnabled( bool enabled ) { m_enabled = enabled; }
+    bool isEnabled() const { return m_enabled; }
+
+    // Frames between two reports
+    void setReportInterval( int frames ) { m_reportInterval = frames; }
+
+    void beginFrame();
+    void endFrame();
+
+    void begin( const char *section );
+    void end( const char *section );
+    void count( const char *counter, int value );
+
+    // Average per frame over the last finished interval
+    double averageMs( const char *section ) const;
+    double averageCount( const char *counter ) const;
+
+private:
+    struct Section
+    {
+        Section() : totalNs( 0 ), lastAverageMs( 0.0 ) {}
+
+        QElapsedTimer timer;
+        qint64 totalNs;
+        double lastAverageMs;
+    };
+
+    struct Counter
+    {
+        Counter() : total( 0 ), lastAverage( 0.0 ) {}
+
+        qint64 total;
+        double lastAverage;
+    };
+
+    void report();
+
+private:
+    std::map<std::string, Section> m_sections;
+    std::map<std::string, Counter> m_counters;
+    QElapsedTimer m_frameTimer;
+    qint64 m_frameTotalNs;
+    int m_frames;
+    int m_reportInterval;
+    bool m_enabled;
+};
+
+#endif // PROFILER_H
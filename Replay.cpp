@@ -0,0 +1,167 @@
+#include "Replay.h"
+#include <algorithm>
+#include <QDebug>
+
+///////////////////////////////////////////////////////
+// Log format. All values are big endian, as QDataStream
+// writes them, and floats are single precision.
+static const quint32 REPLAY_MAGIC = 0x58545250;     // "XTRP"
+static const quint16 REPLAY_VERSION = 1;
+
+ReplayRecorder::ReplayRecorder() :
+    m_ticks( 0 )
+{
+}
+
+ReplayRecorder::~ReplayRecorder()
+{
+    close();
+}
+
+bool ReplayRecorder::open( const QString &path, int views, const QSize &windowSize )
+{
+    close();
+
+    m_file.setFileName( path );
+    if ( !m_file.open( QIODevice::WriteOnly | QIODevice::Truncate ) ) {
+        qWarning() << "Cannot write" << path;
+        return false;
+    }
+
+    m_out.setDevice( &m_file );
+    m_out.setVersion( QDataStream::Qt_4_6 );
+    m_out.setFloatingPointPrecision( QDataStream::SinglePrecision );
+
+    m_out << REPLAY_MAGIC << REPLAY_VERSION << ( quint8 ) views
+          << ( quint16 ) windowSize.width() << ( quint16 ) windowSize.height();
+
+    m_ticks = 0;
+    m_clock.start();
+    return true;
+}
+
+void ReplayRecorder::close()
+{
+    if ( !m_file.isOpen() )
+        return;
+
+    m_out.setDevice( 0 );
+    m_file.close();
+    qDebug() << "Recorded" << m_ticks << "ticks to" << m_file.fileName();
+}
+
+void ReplayRecorder::tick( float dt )
+{
+    m_out << ( quint8 ) ReplayEvent::Tick << ( quint32 ) m_clock.elapsed() << dt;
+    ++m_ticks;
+}
+
+void ReplayRecorder::key( int view, int key )
+{
+    m_out << ( quint8 ) ReplayEvent::Key << ( quint32 ) m_clock.elapsed()
+          << ( quint8 ) view << ( qint32 ) key;
+}
+
+ReplayPlayer::ReplayPlayer() :
+    m_next( 0 ),
+    m_views( 1 ),
+    m_ticks( 0 ),
+    m_open( false )
+{
+}
+
+bool ReplayPlayer::open( const QString &path )
+{
+    QFile file( path );
+    if ( !file.open( QIODevice::ReadOnly ) ) {
+        qWarning() << "Cannot read" << path;
+        return false;
+    }
+
+    QDataStream in( &file );
+    in.setVersion( QDataStream::Qt_4_6 );
+    in.setFloatingPointPrecision( QDataStream::SinglePrecision );
+
+    quint32 magic;
+    quint16 version, width, height;
+    quint8 views;
+    in >> magic >> version >> views >> width >> height;
+    if ( in.status() != QDataStream::Ok || magic != REPLAY_MAGIC ||
+         version != REPLAY_VERSION ) {
+        qWarning() << path << "is not a replay log";
+        return false;
+    }
+
+    m_events.clear();
+    m_next = 0;
+    m_views = std::max( ( int ) views, 1 );
+    m_windowSize = QSize( width, height );
+    m_ticks = 0;
+
+    while ( !in.atEnd() ) {
+        ReplayEvent event;
+        event.view = 0;
+        event.dt = 0.0f;
+        event.key = 0;
+
+        in >> event.type >> event.time;
+        if ( event.type == ReplayEvent::Tick ) {
+            in >> event.dt;
+            ++m_ticks;
+        } else if ( event.type == ReplayEvent::Key ) {
+            in >> event.view >> event.key;
+        } else {
+            in.setStatus( QDataStream::ReadCorruptData );
+        }
+
+        // A log cut short by a crash still replays up to the damage
+        if ( in.status() != QDataStream::Ok ) {
+            qWarning() << "Replay log" << path << "is damaged after"
+                       << m_events.size() << "events";
+            break;
+        }
+
+        m_events.push_back( event );
+    }
+
+    m_open = true;
+    return true;
+}
+
+quint32 ReplayPlayer::duration() const
+{
+    return m_events.empty() ? 0 : m_events.back().time;
+}
+
+///////////////////////////////////////////////////////
+// Print the frame time distribution. The percentiles
+// matter more than the mean: a regression often shows
+// up as a few long frames, not a slower average.
+void ReplayStats::report() const
+{
+    if ( m_frameMs.empty() )
+        return;
+
+    std::vector<double> sorted( m_frameMs );
+    std::sort( sorted.begin(), sorted.end() );
+
+    double total = 0.0;
+    for ( size_t i = 0; i < sorted.size(); ++i ) {
+        total += sorted[i];
+    }
+
+    const size_t last = sorted.size() - 1;
+    QString line = QString( "replay %1 frames in %2 s | min %3 | mean %4 | "
+                            "median %5 | p95 %6 | p99 %7 | max %8 ms" )
+            .arg( ( int ) sorted.size() )
+            .arg( total / 1000.0, 0, 'f', 2 )
+            .arg( sorted.front(), 0, 'f', 2 )
+            .arg( total / sorted.size(), 0, 'f', 2 )
+            .arg( sorted[last / 2], 0, 'f', 2 )
+            .arg( sorted[last * 95 / 100], 0, 'f', 2 )
+            .arg( sorted[last * 99 / 100], 0, 'f', 2 )
+            .arg( sorted.back(), 0, 'f', 2 );
+    line += QString( " | terrain built %1 ms" ).arg( m_buildMs, 0, 'f', 2 );
+
+    qDebug() << qPrintable( line );
+}
@@ -0,0 +1,102 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <vector>
+#include <QFile>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QString>
+#include <QSize>
+
+struct ReplayEvent
+{
+    enum Type { Tick, Key };
+
+    quint8 type;
+    quint8 view;                    // Key: index of the view that had focus
+    quint32 time;                   // Milliseconds since recording started
+    float dt;                       // Tick: seconds the simulation stepped
+    qint32 key;                     // Key: Qt::Key code
+};
+
+///////////////////////////////////////////////////////
+// Writes a replay log: a short header with the number
+// of views and the window size, then one record per
+// simulation tick and per key press, in order. A tick
+// is 9 bytes and a key press 10, so an hour of input
+// at 100 ticks a second stays around 3 MB.
+class ReplayRecorder
+{
+public:
+    ReplayRecorder();
+    ~ReplayRecorder();
+
+    bool open( const QString &path, int views, const QSize &windowSize );
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    void tick( float dt );
+    void key( int view, int key );
+
+    int ticks() const { return m_ticks; }
+
+private:
+    QFile m_file;
+    QDataStream m_out;
+    QElapsedTimer m_clock;
+    int m_ticks;
+};
+
+///////////////////////////////////////////////////////
+// Reads a whole replay log into memory up front, so
+// that playing it back never waits on the disk
+class ReplayPlayer
+{
+public:
+    ReplayPlayer();
+
+    bool open( const QString &path );
+    bool isOpen() const { return m_open; }
+
+    int views() const { return m_views; }
+    QSize windowSize() const { return m_windowSize; }
+    int ticks() const { return m_ticks; }
+    quint32 duration() const;      // Milliseconds the recording lasted
+
+    bool atEnd() const { return m_next >= m_events.size(); }
+    const ReplayEvent &next() { return m_events[m_next++]; }
+
+private:
+    std::vector<ReplayEvent> m_events;
+    size_t m_next;
+    QSize m_windowSize;
+    int m_views;
+    int m_ticks;
+    bool m_open;
+};
+
+///////////////////////////////////////////////////////
+// Frame times of a replay, summarised as percentiles
+// so that runs can be compared against each other.
+// Work a live run does off the main thread is summed
+// apart from the frames it was done in.
+class ReplayStats
+{
+public:
+    ReplayStats() : m_buildMs( 0.0 ) {}
+
+    void clear() { m_frameMs.clear(); m_buildMs = 0.0; }
+    void add( double frameMs, double buildMs )
+    {
+        m_frameMs.push_back( frameMs );
+        m_buildMs += buildMs;
+    }
+
+    void report() const;
+
+private:
+    std::vector<double> m_frameMs;
+    double m_buildMs;                   // Terrain built outside the frame times
+};
+
+#endif // REPLAY_H
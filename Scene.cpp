@@ -1,7 +1,25 @@
 #include "Scene.h"
 #include <GL/glu.h>
 #include <math.h>
+#include <algorithm>
 #include <QDebug>
+#include <QDir>
+#include <QDateTime>
+
+///////////////////////////////////////////////////////
+// OpenGL 1.4 shadow tokens missing from some gl.h
+#ifndef GL_DEPTH_TEXTURE_MODE
+#define GL_DEPTH_TEXTURE_MODE 0x884B
+#endif
+#ifndef GL_TEXTURE_COMPARE_MODE
+#define GL_TEXTURE_COMPARE_MODE 0x884C
+#endif
+#ifndef GL_TEXTURE_COMPARE_FUNC
+#define GL_TEXTURE_COMPARE_FUNC 0x884D
+#endif
+#ifndef GL_COMPARE_R_TO_TEXTURE
+#define GL_COMPARE_R_TO_TEXTURE 0x884E
+#endif
 
 ///////////////////////////////////////////////////////
 // Useful constants
@@ -12,34 +30,103 @@
 // Radians are king... but we need a way to swap back and forth
 #define gltDegToRad(x)	((x)*GLT_PI_DIV_180)
 
-Scene::Scene( QWidget *parent ) :
-    QGLWidget( parent ),
-    m_yRot( 0.0f )
+///////////////////////////////////////////////////////
+// Snowfall settings
+static const size_t SNOW_MIN_FLAKES = 1000;
+
+///////////////////////////////////////////////////////
+// View and lighting settings
+static const GLfloat VIEW_FOV = 35.0f;
+static const GLfloat VIEW_NEAR = 1.0f;
+static const GLfloat VIEW_FAR = 50.0f;
+static const GLfloat TREE_RADIUS = 1.75f;          // Bounding sphere of the cube
+static const GLfloat TREE_INNER_RADIUS = 1.0f;     // Sphere inside the cube however it turns
+static const GLTVector4 LIGHT_DIRECTION = { 0.4f, 1.0f, 0.6f, 0.0f };
+static const GLfloat LIGHT_AMBIENT = 0.35f;
+static const GLfloat LIGHT_DIFFUSE = 0.75f;
+
+///////////////////////////////////////////////////////
+// Shadow settings. The shadow pass draws at most
+// SHADOW_MAX_CASTERS trees from the frustum list, so its
+// cost stays bounded however dense the forest gets.
+static const int SHADOW_DEFAULT_SIZE = 1024;
+static const size_t SHADOW_MAX_CASTERS = 64;
+static const GLfloat SHADOW_RADIUS = 20.0f;        // Half size of the shadowed area
+static const GLfloat SHADOW_LIGHT_DISTANCE = 50.0f;
+
+///////////////////////////////////////////////////////
+// Occlusion settings. Only the nearest trees are drawn
+// into the occlusion buffer; far ones cover too little
+// of it to hide anything.
+static const size_t OCCLUSION_MAX_OCCLUDERS = 32;
+
+// Centre of the field the cameras orbit, where the first tree stands
+static const GLfloat ORBIT_CENTER_Z = -7.0f;
+
+Scene::Scene( QWidget *parent, Scene *shareWidget ) :
+    QGLWidget( parent, shareWidget ),
+    m_world( shareWidget ? shareWidget->m_world : QSharedPointer<World>( new World ) ),
+    m_shadowsSupported( false ),
+    m_shadowMapSize( SHADOW_DEFAULT_SIZE ),
+    m_shadowTextureSize( 0 ),
+    m_shadowTextureID( 0 ),
+    m_width( 1 ),
+    m_height( 1 ),
+    m_captureDropped( 0 )
 {
     this->setFocusPolicy( Qt::StrongFocus );
 
-    connect( &m_timer, SIGNAL( timeout() ),
-             this, SLOT( slotUpdate() ) );
+    gltInitFrame( &frameCamera );  // Initialize the camera
 
-    m_timer.start( 10 );
+    // The world repaints every view after each simulation step
+    m_world->addView( this );
 }
 
-void Scene::slotUpdate()
+Scene::~Scene()
 {
-    m_yRot += 0.1;
-    updateGL();
+    m_world->removeView( this );
+}
+
+///////////////////////////////////////////////////////////
+// Put the camera on the circle through the start position
+// around the field centre, looking at the centre. Angle 0
+// is the start position, angles are in degrees.
+void Scene::setCameraOrbit( GLfloat angle )
+{
+    GLfloat radians = ( GLfloat ) gltDegToRad( angle );
+    GLfloat radius = -ORBIT_CENTER_Z;
+
+    frameCamera.vLocation[0] = radius * sinf( radians );
+    frameCamera.vLocation[2] = ORBIT_CENTER_Z + radius * cosf( radians );
+    frameCamera.vForward[0] = -sinf( radians );
+    frameCamera.vForward[1] = 0.0f;
+    frameCamera.vForward[2] = -cosf( radians );
+
+    followGround();
+}
+
+// Keep the eye at the same height above the snow
+void Scene::followGround()
+{
+    frameCamera.vLocation[1] = m_world->terrain().heightAt( frameCamera.vLocation[0],
+                                                            frameCamera.vLocation[2] ) + 0.4f;
+}
+
+void Scene::setShadowMapSize( int size )
+{
+    m_shadowMapSize = ( size > 0 ) ? size : 0;
 }
 
 void Scene::initializeGL()
 {
+    initializeGLFunctions();
+
     // Bluish background
     glClearColor(0.0f, 0.0f, .50f, 1.0f );
 
     // Draw everything as wire frame
     //glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
 
-    gltInitFrame( &frameCamera );  // Initialize the camera
-
     // Set drawing color to green
     //glColor3f( 0.0f, 1.0f, 0.0f );
 
@@ -48,18 +135,55 @@ void Scene::initializeGL()
 
     glEnable( GL_TEXTURE_2D);
 
-    initField();
-    initCube();
-
-    genTexture();
+    // One directional light; material colour follows glColor
+    glEnable( GL_LIGHTING );
+    glEnable( GL_LIGHT0 );
+    glEnable( GL_COLOR_MATERIAL );
+    glColorMaterial( GL_FRONT, GL_AMBIENT_AND_DIFFUSE );
+    GLfloat noAmbient[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+    glLightModelfv( GL_LIGHT_MODEL_AMBIENT, noAmbient );
+    setLight( LIGHT_AMBIENT, LIGHT_DIFFUSE );
+
+    // Depth textures and the depth comparison are core in OpenGL 1.4
+    m_shadowsSupported = ( QGLFormat::openGLVersionFlags() &
+                           QGLFormat::OpenGL_Version_1_4 ) &&
+            hasOpenGLFeature( QGLFunctions::Multitexture );
+    if ( !m_shadowsSupported )
+        qDebug() << "Shadow mapping not supported, drawing without shadows";
+
+    // Textures are created once and shared by every view
+    if ( m_world->views() > 1 && !isSharing() )
+        qWarning() << "GL context is not shared, views will miss textures";
+    m_world->initializeGL();
 
     // Enable the vertex array
     glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_NORMAL_ARRAY );
     glEnableClientState( GL_TEXTURE_COORD_ARRAY );
 }
 
 void Scene::paintGL()
 {
+    m_profiler.beginFrame();
+
+    cullFrame();
+
+    // Largest power of two that fits both the request and the window
+    int shadowSize = 0;
+    if ( m_shadowsSupported && m_shadowMapSize > 0 ) {
+        int limit = std::min( m_shadowMapSize, std::min( m_width, m_height ) );
+        for ( shadowSize = 1; shadowSize * 2 <= limit; shadowSize *= 2 )
+            ;
+    }
+
+    if ( shadowSize > 0 ) {
+        m_profiler.begin( "shadow" );
+        drawShadowMap( shadowSize );
+        m_profiler.end( "shadow" );
+    }
+
+    m_profiler.begin( "draw" );
+
     // Clear the window with current clearing color
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);
@@ -68,21 +192,69 @@ void Scene::paintGL()
     glPushMatrix();
     {
         gltApplyCameraTransform( &frameCamera );
-        glPushMatrix();
-        {
-            drawGround();
+        glLightfv( GL_LIGHT0, GL_POSITION, LIGHT_DIRECTION );
+
+        if ( shadowSize > 0 ) {
+            // Ambient pass lays down depth and the unlit colour
+            setLight( LIGHT_AMBIENT, 0.0f );
+            drawWorld();
+
+            // Diffuse pass is added on top, masked by the shadow map
+            setLight( 0.0f, LIGHT_DIFFUSE );
+            enableShadowTexture();
+            glDepthFunc( GL_LEQUAL );
+            glEnable( GL_BLEND );
+            glBlendFunc( GL_ONE, GL_ONE );
+
+            drawWorld();
+
+            glDisable( GL_BLEND );
+            glDepthFunc( GL_LESS );
+            disableShadowTexture();
+        } else {
+            setLight( LIGHT_AMBIENT, LIGHT_DIFFUSE );
+            drawWorld();
         }
-        glPopMatrix();
 
-        glPushMatrix();
-        {
-            glTranslatef( 0.0f, 0.8f, -7.0f );
-            glRotatef( m_yRot, 0.0f, 1.0f, 0.0f );
-            drawCube();
-        }
-        glPopMatrix();
+        drawSnow();
     }
     glPopMatrix();
+
+    m_profiler.end( "draw" );
+
+    if ( m_capture.isActive() ) {
+        m_profiler.begin( "capture" );
+        m_capture.capture();
+        m_profiler.end( "capture" );
+        m_profiler.count( "capture dropped", m_capture.framesDropped() - m_captureDropped );
+        m_captureDropped = m_capture.framesDropped();
+    }
+
+    m_profiler.endFrame();
+}
+
+void Scene::updateHeadless()
+{
+    m_width = std::max( 1, width() );
+    m_height = std::max( 1, height() );
+
+    m_profiler.beginFrame();
+    cullFrame();
+    m_profiler.endFrame();
+}
+
+void Scene::cullFrame()
+{
+    m_profiler.begin( "cull" );
+    cullTrees();
+    m_profiler.end( "cull" );
+
+    m_profiler.begin( "occlusion" );
+    cullOccluded();
+    m_profiler.end( "occlusion" );
+    m_profiler.count( "occlusion tested", ( int ) m_frustumList.size() );
+    m_profiler.count( "occlusion culled", ( int ) ( m_frustumList.size() - m_drawList.size() ) );
+    m_profiler.count( "trees drawn", ( int ) m_drawList.size() );
 }
 
 void Scene::resizeGL(int w, int h)
@@ -95,6 +267,12 @@ void Scene::resizeGL(int w, int h)
         h = 1;
 
     glViewport(0, 0, w, h);
+    m_width = w;
+    m_height = h;
+
+    // Captured frames all have the size capture started with
+    if ( m_capture.isActive() )
+        m_capture.end();
 
     fAspect = (GLfloat)w / (GLfloat)h;
 
@@ -103,7 +281,7 @@ void Scene::resizeGL(int w, int h)
     glLoadIdentity();
 
     // Set the clipping volume
-    gluPerspective(35.0f, fAspect, 1.0f, 50.0f);
+    gluPerspective(VIEW_FOV, fAspect, VIEW_NEAR, VIEW_FAR);
 
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -111,7 +289,19 @@ void Scene::resizeGL(int w, int h)
 
 void Scene::keyPressEvent( QKeyEvent *event )
 {
-    switch ( event->key() ) {
+    // A replay is driven by its log alone
+    if ( m_world->isReplaying() )
+        return;
+
+    m_world->recordKey( this, event->key() );
+    handleKey( event->key() );
+
+    updateGL();
+}
+
+void Scene::handleKey( int key )
+{
+    switch ( key ) {
         case Qt::Key_Up:
             gltMoveFrameForward(&frameCamera, 0.1f);
             break;
@@ -124,325 +314,365 @@ void Scene::keyPressEvent( QKeyEvent *event )
         case Qt::Key_Right:
             gltRotateFrameLocalY(&frameCamera, -0.1);
             break;
+        case Qt::Key_Plus:
+        case Qt::Key_Equal:
+            m_world->snow().setCount( m_world->snow().count() * 2 );
+            break;
+        case Qt::Key_Minus:
+            if ( m_world->snow().count() / 2 >= SNOW_MIN_FLAKES )
+                m_world->snow().setCount( m_world->snow().count() / 2 );
+            break;
+        case Qt::Key_P:
+            m_profiler.setEnabled( !m_profiler.isEnabled() );
+            break;
+        case Qt::Key_C:
+            if ( !m_world->isHeadless() )
+                toggleCapture( FrameEncoder::ImageSequence );
+            break;
+        case Qt::Key_V:
+            if ( !m_world->isHeadless() )
+                toggleCapture( FrameEncoder::RawYuv );
+            break;
     }
 
-    updateGL();
+    followGround();
+}
+
+///////////////////////////////////////////////////////////
+// Start or stop recording frames into $CHRISTMASTREE_CAPTURE,
+// or "capture" in the working directory. Every capture gets
+// its own directory named by start time and view, so a later
+// capture never overwrites an earlier one.
+void Scene::toggleCapture( FrameEncoder::Format format )
+{
+    makeCurrent();
+
+    if ( m_capture.isActive() ) {
+        m_capture.end();
+        return;
+    }
+
+    QString root = QString::fromLocal8Bit( qgetenv( "CHRISTMASTREE_CAPTURE" ) );
+    if ( root.isEmpty() )
+        root = "capture";
+
+    QString directory = QDir( root ).filePath(
+                QString( "%1-view%2" )
+                .arg( QDateTime::currentDateTime().toString( "yyyyMMdd-hhmmss-zzz" ) )
+                .arg( ( int ) m_world->viewIndex( this ) ) );
+
+    m_captureDropped = 0;
+    m_capture.begin( directory, format, m_width, m_height );
 }
 
 ///////////////////////////////////////////////////////////
-// Draw a gridded ground
+// Draw the terrain tiles around the camera
 void Scene::drawGround()
 {
-    glBindTexture( GL_TEXTURE_2D, m_groundTextureID );
-    glVertexPointer( 3, GL_FLOAT, 0, m_ground.vertices.data() );
-    glTexCoordPointer( 2, GL_FLOAT, 0, m_ground.textures.data() );
-    glDrawElements( GL_TRIANGLES, m_ground.indices.size(), GL_UNSIGNED_INT,
-                    m_ground.indices.data() );
+    glBindTexture( GL_TEXTURE_2D, m_world->groundTextureID() );
+    m_world->terrain().draw( frameCamera.vLocation[0], frameCamera.vLocation[2] );
 }
 
-void Scene::drawCube()
+void Scene::drawTree( const Tree &tree )
 {
-    glBindTexture( GL_TEXTURE_2D, m_cubeTextureID );
-    glVertexPointer( 3, GL_FLOAT, 0, m_cube.vertices.data() );
-    glTexCoordPointer( 2, GL_FLOAT, 0, m_cube.textures.data() );
-    glDrawElements( GL_TRIANGLES, m_cube.indices.size(), GL_UNSIGNED_INT,
-                    m_cube.indices.data() );
-}
-
-void Scene::initField()
-{
-    size_t counterOfIndeces = 0;
-    size_t counterOfTextures = 0;
-
-    for ( int z = 20; z >= -19; --z ) {
-        for ( int x = -20; x <= 19; ++x ) {
-            counterOfIndeces += 6;
-            ++counterOfTextures;
-            // 0
-            m_ground.vertices.push_back( ( GLfloat ) x );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) z );
-
-            // 1
-            m_ground.vertices.push_back( ( GLfloat ) ( x + 1 ) );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) z );
-
-            // 2
-            m_ground.vertices.push_back( ( GLfloat ) ( x + 1 ) );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) ( z - 1 ) );
-
-            // 3
-            m_ground.vertices.push_back( ( GLfloat ) x );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) z );
-
-            // 4
-            m_ground.vertices.push_back( ( GLfloat ) ( x + 1 ) );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) ( z - 1 ) );
-
-            // 5
-            m_ground.vertices.push_back( ( GLfloat ) x );
-            m_ground.vertices.push_back( -0.4f );
-            m_ground.vertices.push_back( ( GLfloat ) ( z - 1 ) );
-        }
+    glPushMatrix();
+    {
+        glTranslatef( tree.vLocation[0], tree.vLocation[1], tree.vLocation[2] );
+        glRotatef( m_world->treeRotation(), 0.0f, 1.0f, 0.0f );
+        drawCube();
     }
+    glPopMatrix();
+}
 
-    for ( size_t i = 0; i < counterOfIndeces; ++i ) {
-        m_ground.indices.push_back( i );
+///////////////////////////////////////////////////////////
+// Draw the ground and every tree in the draw list
+void Scene::drawWorld()
+{
+    glColor3f( 1.0f, 1.0f, 1.0f );
+
+    drawGround();
+
+    for ( size_t i = 0; i < m_drawList.size(); ++i ) {
+        drawTree( *m_drawList[i] );
     }
+}
 
-    // Texture
-    for ( size_t i = 0; i < counterOfTextures; ++i ) {
-        m_ground.textures.push_back( 0.0f );
-        m_ground.textures.push_back( 0.0f );
+void Scene::drawCube()
+{
+    const Cube &cube = m_world->cube();
+    glBindTexture( GL_TEXTURE_2D, m_world->cubeTextureID() );
+    glVertexPointer( 3, GL_FLOAT, 0, cube.vertices.data() );
+    glNormalPointer( GL_FLOAT, 0, cube.normals.data() );
+    glTexCoordPointer( 2, GL_FLOAT, 0, cube.textures.data() );
+    glDrawElements( GL_TRIANGLES, cube.indices.size(), GL_UNSIGNED_INT,
+                    cube.indices.data() );
+}
 
-        m_ground.textures.push_back( 1.0f );
-        m_ground.textures.push_back( 0.0f );
+///////////////////////////////////////////////////////////
+// Draw the falling snow as untextured, unlit white points
+void Scene::drawSnow()
+{
+    glDisable( GL_LIGHTING );
+    glDisable( GL_TEXTURE_2D );
+    glDisableClientState( GL_NORMAL_ARRAY );
+    glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    glColor3f( 1.0f, 1.0f, 1.0f );
 
-        m_ground.textures.push_back( 1.0f );
-        m_ground.textures.push_back( 1.0f );
+    m_world->snow().draw();
+    m_profiler.count( "snow flakes", ( int ) m_world->snow().count() );
 
-        m_ground.textures.push_back( 0.0f );
-        m_ground.textures.push_back( 0.0f );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+    glEnableClientState( GL_NORMAL_ARRAY );
+    glEnable( GL_TEXTURE_2D );
+    glEnable( GL_LIGHTING );
+}
 
-        m_ground.textures.push_back( 1.0f );
-        m_ground.textures.push_back( 1.0f );
+///////////////////////////////////////////////////////////
+// Collect the trees whose bounding sphere touches the view
+// frustum into m_frustumList, sorted nearest first. The
+// shadow pass draws from this list, as trees hidden from
+// the camera can still cast shadows into view.
+void Scene::cullTrees()
+{
+    GLTVector3 vRight;
+    gltVectorCrossProduct( frameCamera.vForward, frameCamera.vUp, vRight );
+
+    GLfloat tanY = ( GLfloat ) tan( gltDegToRad( VIEW_FOV * 0.5f ) );
+    GLfloat tanX = tanY * ( GLfloat ) m_width / ( GLfloat ) m_height;
+
+    // Distance from the centre to a side plane grows with the plane angle
+    GLfloat marginX = TREE_RADIUS * sqrtf( 1.0f + tanX * tanX );
+    GLfloat marginY = TREE_RADIUS * sqrtf( 1.0f + tanY * tanY );
+
+    const std::vector<Tree> &trees = m_world->trees();
+    std::vector< std::pair<GLfloat, const Tree*> > visible;
+    for ( size_t i = 0; i < trees.size(); ++i ) {
+        GLTVector3 d;
+        d[0] = trees[i].vLocation[0] - frameCamera.vLocation[0];
+        d[1] = trees[i].vLocation[1] - frameCamera.vLocation[1];
+        d[2] = trees[i].vLocation[2] - frameCamera.vLocation[2];
+
+        GLfloat z = d[0] * frameCamera.vForward[0] + d[1] * frameCamera.vForward[1] +
+                d[2] * frameCamera.vForward[2];
+        if ( z < VIEW_NEAR - TREE_RADIUS || z > VIEW_FAR + TREE_RADIUS )
+            continue;
+
+        GLfloat x = d[0] * vRight[0] + d[1] * vRight[1] + d[2] * vRight[2];
+        if ( fabsf( x ) > z * tanX + marginX )
+            continue;
+
+        GLfloat y = d[0] * frameCamera.vUp[0] + d[1] * frameCamera.vUp[1] +
+                d[2] * frameCamera.vUp[2];
+        if ( fabsf( y ) > z * tanY + marginY )
+            continue;
+
+        visible.push_back( std::make_pair( z, &trees[i] ) );
+    }
 
-        m_ground.textures.push_back( 0.0f );
-        m_ground.textures.push_back( 1.0f );
+    std::sort( visible.begin(), visible.end() );
+
+    m_frustumList.clear();
+    m_frustumView.clear();
+    for ( size_t i = 0; i < visible.size(); ++i ) {
+        const Tree &tree = *visible[i].second;
+        GLTVector3 d;
+        d[0] = tree.vLocation[0] - frameCamera.vLocation[0];
+        d[1] = tree.vLocation[1] - frameCamera.vLocation[1];
+        d[2] = tree.vLocation[2] - frameCamera.vLocation[2];
+
+        m_frustumList.push_back( &tree );
+        m_frustumView.push_back( d[0] * vRight[0] + d[1] * vRight[1] + d[2] * vRight[2] );
+        m_frustumView.push_back( d[0] * frameCamera.vUp[0] + d[1] * frameCamera.vUp[1] +
+                                 d[2] * frameCamera.vUp[2] );
+        m_frustumView.push_back( visible[i].first );
     }
 }
 
-void Scene::initCube()
+///////////////////////////////////////////////////////////
+// Draw the nearest trees into the occlusion buffer and move
+// the trees in the frustum that it does not hide into
+// m_drawList, still nearest first, for the colour passes.
+void Scene::cullOccluded()
 {
-    // 0 1 2
-    m_cube.vertices.push_back( -1.0f );    // X
-    m_cube.vertices.push_back( -1.0f );    // Y
-    m_cube.vertices.push_back( 1.0f );      // Z
+    GLfloat tanY = ( GLfloat ) tan( gltDegToRad( VIEW_FOV * 0.5f ) );
+    GLfloat tanX = tanY * ( GLfloat ) m_width / ( GLfloat ) m_height;
 
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
+    m_occlusion.begin( tanX, tanY, VIEW_NEAR );
 
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
+    size_t occluders = std::min( m_frustumList.size(), OCCLUSION_MAX_OCCLUDERS );
+    for ( size_t i = 0; i < occluders; ++i ) {
+        const GLfloat *v = &m_frustumView[i * 3];
+        m_occlusion.addOccluder( v[0], v[1], v[2], TREE_INNER_RADIUS );
+    }
+    m_occlusion.build();
 
-    // 3 4 5
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
+    m_drawList.clear();
+    for ( size_t i = 0; i < m_frustumList.size(); ++i ) {
+        const GLfloat *v = &m_frustumView[i * 3];
+        if ( m_occlusion.isVisible( v[0], v[1], v[2], TREE_RADIUS ) )
+            m_drawList.push_back( m_frustumList[i] );
+    }
+}
 
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
+void Scene::setLight( GLfloat ambient, GLfloat diffuse )
+{
+    GLfloat vAmbient[] = { ambient, ambient, ambient, 1.0f };
+    GLfloat vDiffuse[] = { diffuse, diffuse, diffuse, 1.0f };
+    glLightfv( GL_LIGHT0, GL_AMBIENT, vAmbient );
+    glLightfv( GL_LIGHT0, GL_DIFFUSE, vDiffuse );
+}
 
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
+///////////////////////////////////////////////////////////
+// (Re)create the depth texture the shadow pass copies into
+void Scene::createShadowMap( int size )
+{
+    if ( m_shadowTextureID == 0 )
+        glGenTextures( 1, &m_shadowTextureID );
+
+    glBindTexture( GL_TEXTURE_2D, m_shadowTextureID );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, size, size, 0,
+                  GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, 0 );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+    // Lookups return 1 where lit and 0 where something is nearer the light
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL );
+    glTexParameteri( GL_TEXTURE_2D, GL_DEPTH_TEXTURE_MODE, GL_LUMINANCE );
+
+    m_shadowTextureSize = size;
+}
 
-    // 6 7 8
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
+///////////////////////////////////////////////////////////
+// Render the trees in the frustum list from the light into
+// the corner of the back buffer and copy the depth into the
+// shadow texture. Trees occluded from the camera are drawn
+// too, as their shadows can still fall where it looks. The
+// light looks at an area just in front of the camera with an
+// orthographic projection.
+void Scene::drawShadowMap( int size )
+{
+    if ( size != m_shadowTextureSize )
+        createShadowMap( size );
 
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
+    GLTVector3 vCenter;
+    vCenter[0] = frameCamera.vLocation[0] + frameCamera.vForward[0] * SHADOW_RADIUS;
+    vCenter[2] = frameCamera.vLocation[2] + frameCamera.vForward[2] * SHADOW_RADIUS;
+    vCenter[1] = m_world->terrain().heightAt( vCenter[0], vCenter[2] );
 
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
+    GLfloat length = sqrtf( LIGHT_DIRECTION[0] * LIGHT_DIRECTION[0] +
+                            LIGHT_DIRECTION[1] * LIGHT_DIRECTION[1] +
+                            LIGHT_DIRECTION[2] * LIGHT_DIRECTION[2] );
+    GLfloat scale = SHADOW_LIGHT_DISTANCE / length;
 
-    // 9 10 11
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    // 12 13 14
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // 15 16 17
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // 18 19 20
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // 21 22 23
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // 24 25 26
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    // 27 28 29
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    // 30 31 32
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // 33 34 35
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    m_cube.vertices.push_back( -1.0f );
-    m_cube.vertices.push_back( 1.0f );
-    m_cube.vertices.push_back( -1.0f );
-
-    // Indices
-    m_cube.indices.push_back( 0 );
-    m_cube.indices.push_back( 1 );
-    m_cube.indices.push_back( 2 );
-
-    m_cube.indices.push_back( 3 );
-    m_cube.indices.push_back( 4 );
-    m_cube.indices.push_back( 5 );
-
-    m_cube.indices.push_back( 6 );
-    m_cube.indices.push_back( 7 );
-    m_cube.indices.push_back( 8 );
-
-    m_cube.indices.push_back( 9 );
-    m_cube.indices.push_back( 10 );
-    m_cube.indices.push_back( 11 );
-
-    m_cube.indices.push_back( 12 );
-    m_cube.indices.push_back( 13 );
-    m_cube.indices.push_back( 14 );
-
-    m_cube.indices.push_back( 15 );
-    m_cube.indices.push_back( 16 );
-    m_cube.indices.push_back( 17 );
-
-    m_cube.indices.push_back( 18 );
-    m_cube.indices.push_back( 19 );
-    m_cube.indices.push_back( 20 );
-
-    m_cube.indices.push_back( 21 );
-    m_cube.indices.push_back( 22 );
-    m_cube.indices.push_back( 23 );
-
-    m_cube.indices.push_back( 24 );
-    m_cube.indices.push_back( 25 );
-    m_cube.indices.push_back( 26 );
-
-    m_cube.indices.push_back( 27 );
-    m_cube.indices.push_back( 28 );
-    m_cube.indices.push_back( 29 );
-
-    m_cube.indices.push_back( 30 );
-    m_cube.indices.push_back( 31 );
-    m_cube.indices.push_back( 32 );
-
-    m_cube.indices.push_back( 33 );
-    m_cube.indices.push_back( 34 );
-    m_cube.indices.push_back( 35 );
-
-    // Texture
-    for ( size_t i = 0; i < 6; ++i ) {
-        m_cube.textures.push_back( 0.0f );
-        m_cube.textures.push_back( 0.0f );
+    GLTMatrix mProjection;
+    GLTMatrix mModelview;
 
-        m_cube.textures.push_back( 1.0f );
-        m_cube.textures.push_back( 0.0f );
+    glViewport( 0, 0, size, size );
 
-        m_cube.textures.push_back( 0.0f );
-        m_cube.textures.push_back( 1.0f );
+    glMatrixMode( GL_PROJECTION );
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho( -SHADOW_RADIUS, SHADOW_RADIUS, -SHADOW_RADIUS, SHADOW_RADIUS,
+             1.0f, SHADOW_LIGHT_DISTANCE * 2.0f );
+    glGetFloatv( GL_PROJECTION_MATRIX, mProjection );
 
-        m_cube.textures.push_back( 1.0f );
-        m_cube.textures.push_back( 0.0f );
+    glMatrixMode( GL_MODELVIEW );
+    glLoadIdentity();
+    gluLookAt( vCenter[0] + LIGHT_DIRECTION[0] * scale,
+               vCenter[1] + LIGHT_DIRECTION[1] * scale,
+               vCenter[2] + LIGHT_DIRECTION[2] * scale,
+               vCenter[0], vCenter[1], vCenter[2],
+               0.0f, 1.0f, 0.0f );
+    glGetFloatv( GL_MODELVIEW_MATRIX, mModelview );
+
+    // Only depth is needed, and the ground receives but never casts
+    glClear( GL_DEPTH_BUFFER_BIT );
+    glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+    glDisable( GL_LIGHTING );
+    glDisable( GL_TEXTURE_2D );
+    glShadeModel( GL_FLAT );
+    glEnable( GL_POLYGON_OFFSET_FILL );
+    glPolygonOffset( 4.0f, 4.0f );
+
+    size_t casters = std::min( m_frustumList.size(), SHADOW_MAX_CASTERS );
+    for ( size_t i = 0; i < casters; ++i ) {
+        drawTree( *m_frustumList[i] );
+    }
+    m_profiler.count( "shadow casters", ( int ) casters );
 
-        m_cube.textures.push_back( 1.0f );
-        m_cube.textures.push_back( 1.0f );
+    glBindTexture( GL_TEXTURE_2D, m_shadowTextureID );
+    glCopyTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, 0, 0, size, size );
 
-        m_cube.textures.push_back( 0.0f );
-        m_cube.textures.push_back( 1.0f );
+    glDisable( GL_POLYGON_OFFSET_FILL );
+    glShadeModel( GL_SMOOTH );
+    glEnable( GL_TEXTURE_2D );
+    glEnable( GL_LIGHTING );
+    glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+
+    glMatrixMode( GL_PROJECTION );
+    glPopMatrix();
+    glMatrixMode( GL_MODELVIEW );
+    glViewport( 0, 0, m_width, m_height );
+
+    // Bias from [-1, 1] clip space into [0, 1] texture space
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef( 0.5f, 0.5f, 0.5f );
+    glScalef( 0.5f, 0.5f, 0.5f );
+    glMultMatrixf( mProjection );
+    glMultMatrixf( mModelview );
+    glGetFloatv( GL_MODELVIEW_MATRIX, m_shadowMatrix );
+    glPopMatrix();
+}
+
+///////////////////////////////////////////////////////////
+// Bind the shadow map to the second texture unit. Eye linear
+// texture coordinates are set while the camera transform is
+// current, so they end up in world space and m_shadowMatrix
+// maps them into the shadow map.
+void Scene::enableShadowTexture()
+{
+    GLfloat sPlane[4], tPlane[4], rPlane[4], qPlane[4];
+    for ( int i = 0; i < 4; ++i ) {
+        sPlane[i] = m_shadowMatrix[i * 4];
+        tPlane[i] = m_shadowMatrix[i * 4 + 1];
+        rPlane[i] = m_shadowMatrix[i * 4 + 2];
+        qPlane[i] = m_shadowMatrix[i * 4 + 3];
     }
+
+    glActiveTexture( GL_TEXTURE1 );
+    glBindTexture( GL_TEXTURE_2D, m_shadowTextureID );
+    glEnable( GL_TEXTURE_2D );
+    glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE );
+
+    glTexGeni( GL_S, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR );
+    glTexGeni( GL_T, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR );
+    glTexGeni( GL_R, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR );
+    glTexGeni( GL_Q, GL_TEXTURE_GEN_MODE, GL_EYE_LINEAR );
+    glTexGenfv( GL_S, GL_EYE_PLANE, sPlane );
+    glTexGenfv( GL_T, GL_EYE_PLANE, tPlane );
+    glTexGenfv( GL_R, GL_EYE_PLANE, rPlane );
+    glTexGenfv( GL_Q, GL_EYE_PLANE, qPlane );
+    glEnable( GL_TEXTURE_GEN_S );
+    glEnable( GL_TEXTURE_GEN_T );
+    glEnable( GL_TEXTURE_GEN_R );
+    glEnable( GL_TEXTURE_GEN_Q );
+
+    glActiveTexture( GL_TEXTURE0 );
+}
+
+void Scene::disableShadowTexture()
+{
+    glActiveTexture( GL_TEXTURE1 );
+    glDisable( GL_TEXTURE_GEN_S );
+    glDisable( GL_TEXTURE_GEN_T );
+    glDisable( GL_TEXTURE_GEN_R );
+    glDisable( GL_TEXTURE_GEN_Q );
+    glDisable( GL_TEXTURE_2D );
+    glActiveTexture( GL_TEXTURE0 );
 }
 
 //////////////////////////////////////////////////////////////////
@@ -623,56 +853,3 @@ void Scene::gltRotateVector( const GLTVector3 vSrcVector,
     vOut[1] = mMatrix[1] * vSrcVector[0] + mMatrix[5] * vSrcVector[1] + mMatrix[9] *  vSrcVector[2];
     vOut[2] = mMatrix[2] * vSrcVector[0] + mMatrix[6] * vSrcVector[1] + mMatrix[10] * vSrcVector[2];
 }
-
-void Scene::genTexture()
-{
-    m_groundTextureID=bindTexture(QPixmap(QString(":textures/Snow.jpg")), GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    m_cubeTextureID=bindTexture(QPixmap(QString(":textures/ChristmasTree.jpg")), GL_TEXTURE_2D);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    //    // Ground
-    //    QImage groundImage;
-    //    groundImage.load( QString(":/textures/Snow.jpg") );
-    //    groundImage = QGLWidget::convertToGLFormat( groundImage );
-
-    //    GLuint textureIDs[2];
-
-    //    glGenTextures( 2, textureIDs );
-
-    //    m_groundTextureID = textureIDs[0];
-    //    m_cubeTextureID = textureIDs[1];
-
-    //    glBindTexture( GL_TEXTURE_2D, m_groundTextureID );
-
-    //    glTexImage2D( GL_TEXTURE_2D, 0, 3,
-    //                  ( GLsizei ) groundImage.width(),
-    //                  ( GLsizei ) groundImage.height(), 0,
-    //                  GL_RGBA, GL_UNSIGNED_BYTE, groundImage.bits() );
-
-    //    QImage cubeImage;
-    //    cubeImage.load( QString(":/textures/picture1.jpg") );
-    //    cubeImage = QGLWidget::convertToGLFormat( cubeImage );
-
-    //    glBindTexture( GL_TEXTURE_2D, m_cubeTextureID );
-
-    //    glTexImage2D( GL_TEXTURE_2D, 0, 3,
-    //                  ( GLsizei ) cubeImage.width(),
-    //                  ( GLsizei ) cubeImage.height(), 0,
-    //                  GL_RGBA, GL_UNSIGNED_BYTE, cubeImage.bits() );
-
-    //    // дополнительные параметры текстурного объекта
-    //    // задаём линейную фильтрацию вблизи:
-    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    //    // задаём линейную фильтрацию вдали:
-    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    //    // задаём: при фильтрации игнорируются тексели, выходящие за границу текстуры для s координаты
-    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    //    // задаём: при фильтрации игнорируются тексели, выходящие за границу текстуры для t координаты
-    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    //    // задаём: цвет текселя полностью замещает цвет фрагмента фигуры
-    //    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-}
@@ -3,10 +3,14 @@
 
 #include <vector>
 #include <QGLWidget>
+#include <QGLFunctions>
 #include <QKeyEvent>
-#include <QTimer>
-#include "Ground.h"
-#include "Cube.h"
+#include <QSharedPointer>
+#include "World.h"
+#include "Tree.h"
+#include "Profiler.h"
+#include "FrameCapture.h"
+#include "OcclusionCuller.h"
 
 ///////////////////////////////////////////////////////
 // Some data types
@@ -21,14 +25,32 @@ typedef struct{                     // The Frame of reference container
     GLTVector3 vForward;
 } GLTFrame;
 
-class Scene : public QGLWidget
+class Scene : public QGLWidget, protected QGLFunctions
 {
     Q_OBJECT
 public:
-    Scene( QWidget *parent = 0 );
+    // Views created with another view as shareWidget show the
+    // same world, sharing its textures and meshes
+    Scene( QWidget *parent = 0, Scene *shareWidget = 0 );
+    ~Scene();
 
-private slots:
-    void slotUpdate();
+    const GLTFrame &camera() const { return frameCamera; }
+    void setCameraOrbit( GLfloat angle );
+
+    // Side of the square shadow map in texels, 0 disables shadows.
+    // Clamped to the window size, as the map is rendered there.
+    void setShadowMapSize( int size );
+    int shadowMapSize() const { return m_shadowMapSize; }
+
+    Profiler &profiler() { return m_profiler; }
+    World &world() { return *m_world; }
+
+    // Act on a key as if it was pressed, without repainting
+    void handleKey( int key );
+
+    // Run the culling of a frame without drawing it, at the
+    // size the widget was laid out at
+    void updateHeadless();
 
 private:
     void initializeGL();
@@ -36,12 +58,23 @@ private:
     void resizeGL( int w, int h );
 
     void keyPressEvent( QKeyEvent *event );
+    void followGround();
+    void toggleCapture( FrameEncoder::Format format );
 
     void drawGround();
     void drawCube();
-    void initField();
-    void initCube();
-    void genTexture();
+    void drawTree( const Tree &tree );
+    void drawWorld();
+    void drawSnow();
+
+    void cullFrame();
+    void cullTrees();
+    void cullOccluded();
+    void setLight( GLfloat ambient, GLfloat diffuse );
+    void createShadowMap( int size );
+    void drawShadowMap( int size );
+    void enableShadowTexture();
+    void disableShadowTexture();
 
     void gltApplyCameraTransform( GLTFrame *pCamera );
     void gltVectorCrossProduct( const GLTVector3 vU,
@@ -61,12 +94,21 @@ private:
     std::vector<GLfloat> m_vertices;
     std::vector<GLfloat> m_textures;
     std::vector<GLuint> m_indices;
-    GLuint m_groundTextureID;
-    GLuint m_cubeTextureID;
-    Ground m_ground;
-    Cube m_cube;
-    QTimer m_timer;
-    GLfloat m_yRot;
+    QSharedPointer<World> m_world;
+    std::vector<const Tree*> m_frustumList; // Trees in the frustum, nearest first
+    std::vector<GLfloat> m_frustumView;     // Their x, y, z in view space
+    std::vector<const Tree*> m_drawList;    // Trees not hidden behind others
+    OcclusionCuller m_occlusion;
+    Profiler m_profiler;
+    bool m_shadowsSupported;
+    int m_shadowMapSize;
+    int m_shadowTextureSize;
+    GLuint m_shadowTextureID;
+    GLTMatrix m_shadowMatrix;               // World to shadow map coordinates
+    int m_width;
+    int m_height;
+    FrameCapture m_capture;
+    int m_captureDropped;                   // Dropped count at the last frame
 };
 
 #endif // SCENE_H
@@ -0,0 +1,167 @@
+#include "Snow.h"
+#include <QGLWidget>
+
+#if defined(__SSE__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 1 )
+#include <xmmintrin.h>
+#define SNOW_USE_SSE
+#endif
+
+Snow::Snow() :
+    m_count( 0 ),
+    m_maxCount( 0 ),
+    m_pointSize( 2.0f ),
+    m_seed( 1 )
+{
+    for ( int i = 0; i < 3; ++i ) {
+        m_min[i] = 0.0f;
+        m_max[i] = 0.0f;
+    }
+}
+
+void Snow::init( size_t maxCount,
+                 float minX, float maxX,
+                 float minY, float maxY,
+                 float minZ, float maxZ )
+{
+    m_min[0] = minX;
+    m_min[1] = minY;
+    m_min[2] = minZ;
+    m_max[0] = maxX;
+    m_max[1] = maxY;
+    m_max[2] = maxZ;
+
+    m_maxCount = maxCount;
+    m_count = maxCount;
+
+    m_x.resize( maxCount );
+    m_y.resize( maxCount );
+    m_z.resize( maxCount );
+    m_vx.resize( maxCount );
+    m_vy.resize( maxCount );
+    m_vz.resize( maxCount );
+    m_vertices.resize( maxCount * 3 );
+
+    for ( size_t i = 0; i < maxCount; ++i ) {
+        m_x[i] = random( minX, maxX );
+        m_y[i] = random( minY, maxY );
+        m_z[i] = random( minZ, maxZ );
+
+        // Slow sideways drift, falling at roughly 1 unit per second
+        m_vx[i] = random( -0.15f, 0.15f );
+        m_vy[i] = random( -1.3f, -0.7f );
+        m_vz[i] = random( -0.15f, 0.15f );
+    }
+
+    pack();
+}
+
+void Snow::setCount( size_t count )
+{
+    m_count = ( count < m_maxCount ) ? count : m_maxCount;
+}
+
+///////////////////////////////////////////////////////
+// Move every flake by its velocity and wrap it back into
+// the box when it leaves it. Flakes that reach the bottom
+// reappear at the top, so the count never changes.
+void Snow::update( float dt )
+{
+    size_t simdCount = 0;
+
+#ifdef SNOW_USE_SSE
+    simdCount = m_count & ~( size_t ) 3;
+
+    const __m128 vdt = _mm_set1_ps( dt );
+    const __m128 minX = _mm_set1_ps( m_min[0] );
+    const __m128 maxX = _mm_set1_ps( m_max[0] );
+    const __m128 minY = _mm_set1_ps( m_min[1] );
+    const __m128 minZ = _mm_set1_ps( m_min[2] );
+    const __m128 maxZ = _mm_set1_ps( m_max[2] );
+    const __m128 width = _mm_set1_ps( m_max[0] - m_min[0] );
+    const __m128 height = _mm_set1_ps( m_max[1] - m_min[1] );
+    const __m128 depth = _mm_set1_ps( m_max[2] - m_min[2] );
+
+    float *px = m_x.data();
+    float *py = m_y.data();
+    float *pz = m_z.data();
+    const float *pvx = m_vx.data();
+    const float *pvy = m_vy.data();
+    const float *pvz = m_vz.data();
+
+    for ( size_t i = 0; i < simdCount; i += 4 ) {
+        __m128 x = _mm_add_ps( _mm_loadu_ps( px + i ),
+                               _mm_mul_ps( _mm_loadu_ps( pvx + i ), vdt ) );
+        __m128 y = _mm_add_ps( _mm_loadu_ps( py + i ),
+                               _mm_mul_ps( _mm_loadu_ps( pvy + i ), vdt ) );
+        __m128 z = _mm_add_ps( _mm_loadu_ps( pz + i ),
+                               _mm_mul_ps( _mm_loadu_ps( pvz + i ), vdt ) );
+
+        // Branchless wrap: add or subtract the box size where out of range
+        x = _mm_sub_ps( x, _mm_and_ps( _mm_cmpgt_ps( x, maxX ), width ) );
+        x = _mm_add_ps( x, _mm_and_ps( _mm_cmplt_ps( x, minX ), width ) );
+        y = _mm_add_ps( y, _mm_and_ps( _mm_cmplt_ps( y, minY ), height ) );
+        z = _mm_sub_ps( z, _mm_and_ps( _mm_cmpgt_ps( z, maxZ ), depth ) );
+        z = _mm_add_ps( z, _mm_and_ps( _mm_cmplt_ps( z, minZ ), depth ) );
+
+        _mm_storeu_ps( px + i, x );
+        _mm_storeu_ps( py + i, y );
+        _mm_storeu_ps( pz + i, z );
+    }
+#endif
+
+    updateScalar( simdCount, m_count, dt );
+
+    pack();
+}
+
+void Snow::draw()
+{
+    if ( m_count == 0 ) {
+        return;
+    }
+
+    glPointSize( m_pointSize );
+    glVertexPointer( 3, GL_FLOAT, 0, m_vertices.data() );
+    glDrawArrays( GL_POINTS, 0, ( GLsizei ) m_count );
+}
+
+// Used for the flakes left over after the SSE loop and
+// on targets without SSE
+void Snow::updateScalar( size_t first, size_t last, float dt )
+{
+    const float width = m_max[0] - m_min[0];
+    const float height = m_max[1] - m_min[1];
+    const float depth = m_max[2] - m_min[2];
+
+    for ( size_t i = first; i < last; ++i ) {
+        m_x[i] += m_vx[i] * dt;
+        m_y[i] += m_vy[i] * dt;
+        m_z[i] += m_vz[i] * dt;
+
+        if ( m_x[i] > m_max[0] ) m_x[i] -= width;
+        if ( m_x[i] < m_min[0] ) m_x[i] += width;
+        if ( m_y[i] < m_min[1] ) m_y[i] += height;
+        if ( m_z[i] > m_max[2] ) m_z[i] -= depth;
+        if ( m_z[i] < m_min[2] ) m_z[i] += depth;
+    }
+}
+
+// Interleave the active flakes for the vertex array
+void Snow::pack()
+{
+    float *v = m_vertices.data();
+    for ( size_t i = 0; i < m_count; ++i ) {
+        v[0] = m_x[i];
+        v[1] = m_y[i];
+        v[2] = m_z[i];
+        v += 3;
+    }
+}
+
+// Small LCG so that a given seed always produces the same snowfall
+float Snow::random( float min, float max )
+{
+    m_seed = m_seed * 1103515245u + 12345u;
+    float t = ( float ) ( ( m_seed >> 8 ) & 0xFFFF ) / 65535.0f;
+    return min + ( max - min ) * t;
+}
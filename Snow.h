@@ -0,0 +1,61 @@
+#ifndef SNOW_H
+#define SNOW_H
+
+#include <vector>
+#include <cstddef>
+
+///////////////////////////////////////////////////////
+// Falling snow. Flakes are stored as a structure of
+// arrays so that update() can integrate four flakes at
+// a time with SSE; draw() submits all of them as points
+// in a single glDrawArrays call.
+class Snow
+{
+public:
+    Snow();
+
+    // Reserve storage for maxCount flakes inside the box
+    // [minX, maxX] x [minY, maxY] x [minZ, maxZ]
+    void init( size_t maxCount,
+               float minX, float maxX,
+               float minY, float maxY,
+               float minZ, float maxZ );
+
+    // Number of flakes simulated and drawn, clamped to maxCount()
+    void setCount( size_t count );
+    size_t count() const { return m_count; }
+    size_t maxCount() const { return m_maxCount; }
+
+    void setPointSize( float size ) { m_pointSize = size; }
+
+    void update( float dt );
+    void draw();
+
+private:
+    void updateScalar( size_t first, size_t last, float dt );
+    void pack();
+    float random( float min, float max );
+
+private:
+    // Position
+    std::vector<float> m_x;
+    std::vector<float> m_y;
+    std::vector<float> m_z;
+
+    // Velocity
+    std::vector<float> m_vx;
+    std::vector<float> m_vy;
+    std::vector<float> m_vz;
+
+    // Interleaved xyz for glVertexPointer
+    std::vector<float> m_vertices;
+
+    size_t m_count;
+    size_t m_maxCount;
+    float m_min[3];
+    float m_max[3];
+    float m_pointSize;
+    unsigned int m_seed;
+};
+
+#endif // SNOW_H
@@ -0,0 +1,359 @@
+#include "Terrain.h"
+#include <QGLWidget>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <math.h>
+#include <stdlib.h>
+#include <algorithm>
+
+///////////////////////////////////////////////////////
+// Terrain settings
+static const float TERRAIN_TILE_SIZE = 32.0f;   // World units per tile side
+static const int TERRAIN_TILE_CELLS = 32;       // Grid cells per tile side
+static const int TERRAIN_VIEW_RADIUS = 2;       // Tiles drawn around the camera
+static const size_t TERRAIN_CACHE_TILES = 49;   // Tiles kept in memory per camera
+static const float TERRAIN_GROUND_LEVEL = -0.4f;
+static const float TERRAIN_HEIGHT_SCALE = 12.0f;
+static const float TERRAIN_FLAT_RADIUS = 20.0f; // Flat snow around the tree
+static const float TERRAIN_BLEND_RADIUS = 40.0f;
+
+///////////////////////////////////////////////////////
+// Value noise
+static float latticeValue( int x, int z )
+{
+    unsigned int n = ( unsigned int ) x * 73856093u ^ ( unsigned int ) z * 19349663u;
+    n = ( n << 13 ) ^ n;
+    n = n * ( n * n * 15731u + 789221u ) + 1376312589u;
+    return ( float ) ( n & 0x7fffffff ) / 2147483647.0f;
+}
+
+static float valueNoise( float x, float z )
+{
+    float fx = floorf( x );
+    float fz = floorf( z );
+    int ix = ( int ) fx;
+    int iz = ( int ) fz;
+
+    // Smoothstep the fractional part to hide the lattice
+    float tx = x - fx;
+    float tz = z - fz;
+    tx = tx * tx * ( 3.0f - 2.0f * tx );
+    tz = tz * tz * ( 3.0f - 2.0f * tz );
+
+    float v00 = latticeValue( ix, iz );
+    float v10 = latticeValue( ix + 1, iz );
+    float v01 = latticeValue( ix, iz + 1 );
+    float v11 = latticeValue( ix + 1, iz + 1 );
+
+    float v0 = v00 + ( v10 - v00 ) * tx;
+    float v1 = v01 + ( v11 - v01 ) * tx;
+    return v0 + ( v1 - v0 ) * tz;
+}
+
+TerrainGenerator::TerrainGenerator( const Terrain *terrain ) :
+    m_terrain( terrain ),
+    m_inFlight( 0, 0 ),
+    m_busy( false ),
+    m_quit( false )
+{
+}
+
+TerrainGenerator::~TerrainGenerator()
+{
+    stop();
+
+    for ( size_t i = 0; i < m_finished.size(); ++i ) {
+        delete m_finished[i];
+    }
+}
+
+void TerrainGenerator::request( const std::vector<TileKey> &keys )
+{
+    QMutexLocker locker( &m_mutex );
+
+    m_pending.clear();
+    for ( size_t i = 0; i < keys.size(); ++i ) {
+        if ( m_busy && keys[i] == m_inFlight )
+            continue;
+
+        bool finished = false;
+        for ( size_t j = 0; j < m_finished.size(); ++j ) {
+            if ( m_finished[j]->key == keys[i] ) {
+                finished = true;
+                break;
+            }
+        }
+
+        if ( !finished )
+            m_pending.push_back( keys[i] );
+    }
+
+    if ( !m_pending.empty() )
+        m_wake.wakeOne();
+}
+
+void TerrainGenerator::takeFinished( std::vector<TerrainTile*> &tiles )
+{
+    QMutexLocker locker( &m_mutex );
+
+    tiles.insert( tiles.end(), m_finished.begin(), m_finished.end() );
+    m_finished.clear();
+}
+
+void TerrainGenerator::stop()
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        m_quit = true;
+        m_wake.wakeOne();
+    }
+
+    wait();
+}
+
+void TerrainGenerator::run()
+{
+    for ( ;; ) {
+        TerrainTile *tile = 0;
+        {
+            QMutexLocker locker( &m_mutex );
+            while ( !m_quit && m_pending.empty() ) {
+                m_wake.wait( &m_mutex );
+            }
+
+            if ( m_quit )
+                return;
+
+            tile = new TerrainTile;
+            tile->key = m_pending.front();
+            tile->lastUsed = 0;
+            m_pending.pop_front();
+
+            m_inFlight = tile->key;
+            m_busy = true;
+        }
+
+        // The mesh is built outside the lock so that paintGL never waits for it
+        m_terrain->buildTile( tile );
+
+        QMutexLocker locker( &m_mutex );
+        m_finished.push_back( tile );
+        m_busy = false;
+    }
+}
+
+Terrain::Terrain() :
+    m_generator( this ),
+    m_cacheTiles( TERRAIN_CACHE_TILES ),
+    m_frame( 0 ),
+    m_synchronous( false ),
+    m_buildNs( 0 )
+{
+}
+
+Terrain::~Terrain()
+{
+    m_generator.stop();
+
+    for ( TileCache::iterator it = m_cache.begin(); it != m_cache.end(); ++it ) {
+        delete it->second;
+    }
+}
+
+void Terrain::start()
+{
+    m_generator.start( QThread::LowPriority );
+}
+
+void Terrain::update( const std::vector< std::pair<float, float> > &cameras )
+{
+    ++m_frame;
+
+    // Move newly built tiles into the cache
+    m_generator.takeFinished( m_finished );
+    for ( size_t i = 0; i < m_finished.size(); ++i ) {
+        TerrainTile *tile = m_finished[i];
+        if ( m_cache.find( tile->key ) != m_cache.end() ) {
+            delete tile;
+            continue;
+        }
+        tile->lastUsed = m_frame;
+        m_cache[tile->key] = tile;
+    }
+    m_finished.clear();
+
+    // Walk rings outwards so the nearest missing tiles are built
+    // first, and mark the tiles every camera needs as used
+    std::vector<TileKey> missing;
+    for ( int r = 0; r <= TERRAIN_VIEW_RADIUS; ++r ) {
+        for ( size_t c = 0; c < cameras.size(); ++c ) {
+            int cameraTileX = ( int ) floorf( cameras[c].first / TERRAIN_TILE_SIZE );
+            int cameraTileZ = ( int ) floorf( cameras[c].second / TERRAIN_TILE_SIZE );
+
+            for ( int dz = -r; dz <= r; ++dz ) {
+                for ( int dx = -r; dx <= r; ++dx ) {
+                    if ( abs( dx ) != r && abs( dz ) != r )
+                        continue;
+
+                    TileKey key( cameraTileX + dx, cameraTileZ + dz );
+                    TileCache::iterator it = m_cache.find( key );
+                    if ( it != m_cache.end() ) {
+                        it->second->lastUsed = m_frame;
+                    } else if ( std::find( missing.begin(), missing.end(), key ) ==
+                                missing.end() ) {
+                        missing.push_back( key );
+                    }
+                }
+            }
+        }
+    }
+
+    m_buildNs = 0;
+    if ( m_synchronous && !missing.empty() ) {
+        QElapsedTimer buildTimer;
+        buildTimer.start();
+
+        for ( size_t i = 0; i < missing.size(); ++i ) {
+            TerrainTile *tile = new TerrainTile;
+            tile->key = missing[i];
+            buildTile( tile );
+            tile->lastUsed = m_frame;
+            m_cache[tile->key] = tile;
+        }
+        missing.clear();
+
+        m_buildNs = buildTimer.nsecsElapsed();
+    }
+
+    m_generator.request( missing );
+
+    m_cacheTiles = TERRAIN_CACHE_TILES * std::max( cameras.size(), ( size_t ) 1 );
+    evict();
+}
+
+void Terrain::draw( float cameraX, float cameraZ )
+{
+    int cameraTileX = ( int ) floorf( cameraX / TERRAIN_TILE_SIZE );
+    int cameraTileZ = ( int ) floorf( cameraZ / TERRAIN_TILE_SIZE );
+
+    for ( int dz = -TERRAIN_VIEW_RADIUS; dz <= TERRAIN_VIEW_RADIUS; ++dz ) {
+        for ( int dx = -TERRAIN_VIEW_RADIUS; dx <= TERRAIN_VIEW_RADIUS; ++dx ) {
+            TileCache::const_iterator it =
+                    m_cache.find( TileKey( cameraTileX + dx, cameraTileZ + dz ) );
+            if ( it == m_cache.end() )
+                continue;
+
+            const Ground &mesh = it->second->mesh;
+            glVertexPointer( 3, GL_FLOAT, 0, mesh.vertices.data() );
+            glNormalPointer( GL_FLOAT, 0, mesh.normals.data() );
+            glTexCoordPointer( 2, GL_FLOAT, 0, mesh.textures.data() );
+            glDrawElements( GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT,
+                            mesh.indices.data() );
+        }
+    }
+}
+
+///////////////////////////////////////////////////////
+// A few octaves of value noise, faded in with distance
+// from the origin so the tree keeps standing on flat snow
+float Terrain::heightAt( float x, float z ) const
+{
+    float h = 0.0f;
+    float amplitude = 1.0f;
+    float frequency = 1.0f / 64.0f;
+    float total = 0.0f;
+
+    for ( int octave = 0; octave < 4; ++octave ) {
+        h += amplitude * valueNoise( x * frequency, z * frequency );
+        total += amplitude;
+        amplitude *= 0.5f;
+        frequency *= 2.0f;
+    }
+    h = h / total - 0.5f;
+
+    float distance = sqrtf( x * x + z * z );
+    float fade = ( distance - TERRAIN_FLAT_RADIUS ) / TERRAIN_BLEND_RADIUS;
+    if ( fade < 0.0f )
+        fade = 0.0f;
+    if ( fade > 1.0f )
+        fade = 1.0f;
+
+    return TERRAIN_GROUND_LEVEL + fade * TERRAIN_HEIGHT_SCALE * h;
+}
+
+void Terrain::buildTile( TerrainTile *tile ) const
+{
+    const int n = TERRAIN_TILE_CELLS;
+    const float cellSize = TERRAIN_TILE_SIZE / n;
+    const float originX = tile->key.first * TERRAIN_TILE_SIZE;
+    const float originZ = tile->key.second * TERRAIN_TILE_SIZE;
+
+    Ground &mesh = tile->mesh;
+    mesh.vertices.reserve( ( n + 1 ) * ( n + 1 ) * 3 );
+    mesh.normals.reserve( ( n + 1 ) * ( n + 1 ) * 3 );
+    mesh.textures.reserve( ( n + 1 ) * ( n + 1 ) * 2 );
+    mesh.indices.reserve( n * n * 6 );
+
+    for ( int j = 0; j <= n; ++j ) {
+        for ( int i = 0; i <= n; ++i ) {
+            float x = originX + i * cellSize;
+            float z = originZ + j * cellSize;
+
+            mesh.vertices.push_back( x );
+            mesh.vertices.push_back( heightAt( x, z ) );
+            mesh.vertices.push_back( z );
+
+            // Normal from central differences of the height field
+            float dx = heightAt( x - cellSize, z ) - heightAt( x + cellSize, z );
+            float dz = heightAt( x, z - cellSize ) - heightAt( x, z + cellSize );
+            float dy = 2.0f * cellSize;
+            float length = sqrtf( dx * dx + dy * dy + dz * dz );
+            mesh.normals.push_back( dx / length );
+            mesh.normals.push_back( dy / length );
+            mesh.normals.push_back( dz / length );
+
+            // One texture repeat per cell, as on the old flat field
+            mesh.textures.push_back( ( GLfloat ) i );
+            mesh.textures.push_back( ( GLfloat ) ( n - j ) );
+        }
+    }
+
+    // Two counter-clockwise triangles per cell, seen from above
+    for ( int j = 0; j < n; ++j ) {
+        for ( int i = 0; i < n; ++i ) {
+            unsigned int near0 = ( j + 1 ) * ( n + 1 ) + i;
+            unsigned int near1 = near0 + 1;
+            unsigned int far0 = j * ( n + 1 ) + i;
+            unsigned int far1 = far0 + 1;
+
+            mesh.indices.push_back( near0 );
+            mesh.indices.push_back( near1 );
+            mesh.indices.push_back( far1 );
+
+            mesh.indices.push_back( near0 );
+            mesh.indices.push_back( far1 );
+            mesh.indices.push_back( far0 );
+        }
+    }
+}
+
+void Terrain::evict()
+{
+    while ( m_cache.size() > m_cacheTiles ) {
+        TileCache::iterator oldest = m_cache.end();
+        for ( TileCache::iterator it = m_cache.begin(); it != m_cache.end(); ++it ) {
+            if ( it->second->lastUsed == m_frame )
+                continue;
+            if ( oldest == m_cache.end() ||
+                 it->second->lastUsed < oldest->second->lastUsed ) {
+                oldest = it;
+            }
+        }
+
+        if ( oldest == m_cache.end() )
+            break;
+
+        delete oldest->second;
+        m_cache.erase( oldest );
+    }
+}
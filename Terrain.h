@@ -0,0 +1,110 @@
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <utility>
+#include <cstddef>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include "Ground.h"
+
+class Terrain;
+
+typedef std::pair<int, int> TileKey;   // Tile column (x) and row (z)
+
+struct TerrainTile
+{
+    TileKey key;
+    Ground mesh;
+    unsigned int lastUsed;             // Frame the tile was last drawn in
+};
+
+///////////////////////////////////////////////////////
+// Background thread that builds tile meshes. The main
+// thread hands it the list of missing tiles every frame
+// and collects the finished ones without waiting.
+class TerrainGenerator : public QThread
+{
+public:
+    explicit TerrainGenerator( const Terrain *terrain );
+    ~TerrainGenerator();
+
+    // Replace the queue of tiles to build, nearest first
+    void request( const std::vector<TileKey> &keys );
+
+    // Move the finished tiles into tiles, never blocks on generation
+    void takeFinished( std::vector<TerrainTile*> &tiles );
+
+    void stop();
+
+protected:
+    void run();
+
+private:
+    const Terrain *m_terrain;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::deque<TileKey> m_pending;
+    std::vector<TerrainTile*> m_finished;
+    TileKey m_inFlight;
+    bool m_busy;
+    bool m_quit;
+};
+
+///////////////////////////////////////////////////////
+// Snowy terrain streamed in square tiles around the
+// camera. Heights come from value noise so that the
+// world has no edge; only a fixed number of tiles is
+// kept in memory and the least recently used one is
+// dropped when the cache is full.
+class Terrain
+{
+public:
+    Terrain();
+    ~Terrain();
+
+    // Start the generator thread
+    void start();
+
+    // Build missing tiles in update() instead of on the generator
+    // thread, so that every frame sees the same tiles on every run
+    void setSynchronous( bool synchronous ) { m_synchronous = synchronous; }
+
+    // Request tiles around every camera (x, z) and pick up
+    // finished ones. The cache grows with the number of cameras.
+    void update( const std::vector< std::pair<float, float> > &cameras );
+
+    // Draw the tiles around a camera that are ready.
+    // Texture and client states are set up by the caller.
+    void draw( float cameraX, float cameraZ );
+
+    // Ground height at a world position, safe to call from any thread
+    float heightAt( float x, float z ) const;
+
+    // Fill tile->mesh for tile->key
+    void buildTile( TerrainTile *tile ) const;
+
+    size_t tileCount() const { return m_cache.size(); }
+
+    // Nanoseconds the last update() spent building tiles itself
+    qint64 lastBuildNs() const { return m_buildNs; }
+
+private:
+    void evict();
+
+private:
+    typedef std::map<TileKey, TerrainTile*> TileCache;
+
+    TerrainGenerator m_generator;
+    TileCache m_cache;
+    size_t m_cacheTiles;
+    std::vector<TerrainTile*> m_finished;
+    unsigned int m_frame;
+    bool m_synchronous;
+    qint64 m_buildNs;
+};
+
+#endif // TERRAIN_H
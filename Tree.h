@@ -0,0 +1,10 @@
+#ifndef TREE_H
+#define TREE_H
+
+class Tree
+{
+public:
+    float vLocation[3];
+};
+
+#endif // TREE_H
@@ -0,0 +1,646 @@
+#include "World.h"
+#include "Scene.h"
+#include <algorithm>
+#include <math.h>
+#include <QDebug>
+
+#ifndef GL_GENERATE_MIPMAP
+#define GL_GENERATE_MIPMAP 0x8191
+#endif
+
+///////////////////////////////////////////////////////
+// Snowfall settings
+static const size_t SNOW_MAX_FLAKES = 400000;
+static const size_t SNOW_DEFAULT_FLAKES = 200000;
+
+///////////////////////////////////////////////////////
+// Assets, relative to the asset directory or the bundle
+static const char *GROUND_TEXTURE = "textures/Snow.jpg";
+static const char *CUBE_TEXTURE = "textures/ChristmasTree.jpg";
+static const char *SCENE_FILE = "scene.txt";
+
+///////////////////////////////////////////////////////
+// Forest settings. Scattered trees keep clear of the
+// field the cameras orbit, and always land in the same
+// places so every run sees the same forest.
+static const GLfloat FOREST_CENTER_Z = -7.0f;
+static const GLfloat FOREST_MIN_RADIUS = 9.0f;
+static const GLfloat FOREST_MAX_RADIUS = 40.0f;
+static const GLfloat FOREST_TREE_HEIGHT = 1.2f;     // Cube centre above the ground
+static const unsigned int FOREST_SEED = 2512u;
+
+World::World( QObject *parent ) :
+    QObject( parent ),
+    m_groundTextureID( 0 ),
+    m_cubeTextureID( 0 ),
+    m_glInitialized( false ),
+    m_generateMipmaps( false ),
+    m_yRot( 0.0f ),
+    m_headless( false ),
+    m_replayStarted( false )
+{
+    initCube();
+    initTrees();
+
+    // Ground tiles are built on a background thread as the cameras move
+    m_terrain.start();
+
+    // Snow falls over the whole field, from a few units above the tree
+    m_snow.init( SNOW_MAX_FLAKES, -20.0f, 20.0f, -0.4f, 6.0f, -20.0f, 20.0f );
+    m_snow.setCount( SNOW_DEFAULT_FLAKES );
+
+    connect( &m_timer, SIGNAL( timeout() ),
+             this, SLOT( slotUpdate() ) );
+
+    m_timer.start( 10 );
+    m_frameTimer.start();
+}
+
+World::~World()
+{
+    m_timer.stop();
+}
+
+void World::addView( Scene *view )
+{
+    m_views.push_back( view );
+}
+
+void World::removeView( Scene *view )
+{
+    m_views.erase( std::remove( m_views.begin(), m_views.end(), view ),
+                   m_views.end() );
+}
+
+size_t World::viewIndex( const Scene *view ) const
+{
+    return std::find( m_views.begin(), m_views.end(), view ) - m_views.begin();
+}
+
+bool World::record( const QString &path, const QSize &windowSize )
+{
+    return m_recorder.open( path, ( int ) m_views.size(), windowSize );
+}
+
+void World::recordKey( Scene *view, int key )
+{
+    if ( !m_recorder.isOpen() )
+        return;
+
+    m_recorder.key( ( int ) viewIndex( view ), key );
+}
+
+bool World::replay( const QString &path, bool headless )
+{
+    if ( !m_player.open( path ) )
+        return false;
+
+    qDebug() << "Replaying" << m_player.ticks() << "ticks recorded over"
+             << m_player.duration() / 1000.0 << "s";
+
+    // Streamed ground is built in step with the replay, and
+    // ticks follow each other as soon as the last one is done
+    m_terrain.setSynchronous( true );
+    m_headless = headless;
+    m_replayStarted = false;
+    m_replayStats.clear();
+    m_timer.start( 0 );
+    return true;
+}
+
+void World::initializeGL()
+{
+    if ( m_glInitialized )
+        return;
+
+    // Mipmap generation is core in OpenGL 1.4
+    m_generateMipmaps = ( QGLFormat::openGLVersionFlags() &
+                          QGLFormat::OpenGL_Version_1_4 );
+
+    genTexture();
+
+    m_glInitialized = true;
+}
+
+///////////////////////////////////////////////////////////
+// Step the simulation once for all views and repaint them
+void World::slotUpdate()
+{
+    // A live run streams the ground in before anyone looks, so a
+    // replay builds the tiles around the starting cameras untimed
+    if ( m_player.isOpen() && !m_replayStarted ) {
+        m_terrain.update( cameraPositions() );
+        m_replayStarted = true;
+    }
+
+    QElapsedTimer tickTimer;
+    tickTimer.start();
+
+    // Seconds since the previous tick, clamped so that a stalled
+    // window does not throw all the snow through the ground at once
+    GLfloat dt = m_frameTimer.restart() / 1000.0f;
+    if ( dt > 0.1f )
+        dt = 0.1f;
+
+    if ( m_player.isOpen() && !replayEvents( dt ) )
+        return;
+
+    if ( m_recorder.isOpen() )
+        m_recorder.tick( dt );
+
+    // Textures are shared, so any view's context can swap them in.
+    // Doing it here keeps the swap between frames for every view.
+    // Replays keep the assets they started with, to stay repeatable.
+    // The upload is timed in the first view's profiler with its frames.
+    if ( m_glInitialized && !m_views.empty() && !m_player.isOpen() ) {
+        Profiler &profiler = m_views[0]->profiler();
+        m_views[0]->makeCurrent();
+
+        profiler.begin( "assets" );
+        applyLoadedAssets();
+        profiler.end( "assets" );
+    }
+
+    m_yRot += 0.1;
+    m_snow.update( dt );
+
+    // Pick up finished terrain tiles and queue the ones now in view
+    m_terrain.update( cameraPositions() );
+
+    for ( size_t i = 0; i < m_views.size(); ++i ) {
+        if ( m_headless )
+            m_views[i]->updateHeadless();
+        else
+            m_views[i]->updateGL();
+    }
+
+    // Tiles a replay builds itself are built on the generator
+    // thread in a live run, so they are kept out of the frame time
+    if ( m_player.isOpen() ) {
+        qint64 buildNs = m_terrain.lastBuildNs();
+        m_replayStats.add( ( tickTimer.nsecsElapsed() - buildNs ) / 1.0e6, buildNs / 1.0e6 );
+    }
+}
+
+std::vector< std::pair<float, float> > World::cameraPositions() const
+{
+    std::vector< std::pair<float, float> > cameras;
+    for ( size_t i = 0; i < m_views.size(); ++i ) {
+        const GLTFrame &camera = m_views[i]->camera();
+        cameras.push_back( std::make_pair( camera.vLocation[0], camera.vLocation[2] ) );
+    }
+    return cameras;
+}
+
+///////////////////////////////////////////////////////////
+// Apply the logged key presses up to the next tick and take
+// its time step. At the end of the log the statistics are
+// printed and the timer stopped.
+bool World::replayEvents( GLfloat &dt )
+{
+    while ( !m_player.atEnd() ) {
+        const ReplayEvent &event = m_player.next();
+
+        if ( event.type == ReplayEvent::Tick ) {
+            dt = event.dt;
+            return true;
+        }
+
+        if ( event.view < m_views.size() )
+            m_views[event.view]->handleKey( event.key );
+    }
+
+    m_timer.stop();
+    m_replayStats.report();
+    emit replayFinished();
+    return false;
+}
+
+///////////////////////////////////////////////////////////
+// Place the trees listed in the scene file, or a single
+// tree in front of the camera if it cannot be read
+void World::initTrees()
+{
+    LoadedAsset asset;
+    if ( Assets::load( SCENE_FILE, m_assets.path( SCENE_FILE ), asset ) ) {
+        setTrees( asset );
+    } else {
+        qWarning() << "Cannot read" << SCENE_FILE;
+
+        Tree tree;
+        tree.vLocation[0] = 0.0f;
+        tree.vLocation[1] = 0.8f;
+        tree.vLocation[2] = -7.0f;
+        m_trees.push_back( tree );
+    }
+
+    m_assets.watch( SCENE_FILE );
+}
+
+void World::setTrees( const LoadedAsset &scene )
+{
+    m_trees.clear();
+
+    const std::vector<float> &locations = scene.trees;
+    for ( size_t i = 0; i + 2 < locations.size(); i += 3 ) {
+        Tree tree;
+        tree.vLocation[0] = locations[i];
+        tree.vLocation[1] = locations[i + 1];
+        tree.vLocation[2] = locations[i + 2];
+        m_trees.push_back( tree );
+    }
+
+    unsigned int seed = FOREST_SEED;
+    for ( int i = 0; i < scene.forest; ++i ) {
+        GLfloat r[2];
+        for ( int j = 0; j < 2; ++j ) {
+            seed = seed * 1103515245u + 12345u;
+            r[j] = ( GLfloat ) ( ( seed >> 8 ) & 0xFFFF ) / 65535.0f;
+        }
+
+        // Uniform over the ring between the two radii
+        GLfloat minSq = FOREST_MIN_RADIUS * FOREST_MIN_RADIUS;
+        GLfloat maxSq = FOREST_MAX_RADIUS * FOREST_MAX_RADIUS;
+        GLfloat radius = sqrtf( minSq + r[0] * ( maxSq - minSq ) );
+        GLfloat angle = r[1] * 6.2831853f;
+
+        Tree tree;
+        tree.vLocation[0] = radius * sinf( angle );
+        tree.vLocation[2] = FOREST_CENTER_Z + radius * cosf( angle );
+        tree.vLocation[1] = m_terrain.heightAt( tree.vLocation[0], tree.vLocation[2] ) +
+                FOREST_TREE_HEIGHT;
+        m_trees.push_back( tree );
+    }
+}
+
+///////////////////////////////////////////////////////////
+// Apply the assets the loader thread has finished. Scene
+// data is cheap to swap, but only one texture is uploaded
+// per frame so a reload never costs more than one frame.
+void World::applyLoadedAssets()
+{
+    std::vector<LoadedAsset> loaded;
+    m_assets.takeLoaded( loaded );
+    m_pendingAssets.insert( m_pendingAssets.end(), loaded.begin(), loaded.end() );
+
+    bool uploaded = false;
+    while ( !m_pendingAssets.empty() ) {
+        const LoadedAsset &asset = m_pendingAssets.front();
+
+        if ( asset.name == GROUND_TEXTURE || asset.name == CUBE_TEXTURE ) {
+            if ( uploaded )
+                break;
+            uploaded = true;
+
+            if ( asset.name == GROUND_TEXTURE )
+                replaceTexture( m_groundTextureID, asset.image, GL_REPEAT );
+            else
+                replaceTexture( m_cubeTextureID, asset.image, GL_CLAMP_TO_EDGE );
+        } else if ( asset.name == SCENE_FILE ) {
+            setTrees( asset );
+        }
+
+        qDebug() << "Reloaded" << asset.name;
+        m_pendingAssets.pop_front();
+    }
+}
+
+///////////////////////////////////////////////////////////
+// Create a texture from an image in GL format
+GLuint World::uploadTexture( const QImage &image, GLint wrap )
+{
+    GLuint textureID;
+    glGenTextures( 1, &textureID );
+    glBindTexture( GL_TEXTURE_2D, textureID );
+
+    if ( m_generateMipmaps ) {
+        glTexParameteri( GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE );
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR );
+    } else {
+        glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    }
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap );
+
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA,
+                  ( GLsizei ) image.width(),
+                  ( GLsizei ) image.height(), 0,
+                  GL_RGBA, GL_UNSIGNED_BYTE, image.bits() );
+
+    return textureID;
+}
+
+// Swap a texture for a new one, keeping the old one if the image is bad
+void World::replaceTexture( GLuint &textureID, const QImage &image, GLint wrap )
+{
+    if ( image.isNull() )
+        return;
+
+    GLuint newTextureID = uploadTexture( image, wrap );
+    glDeleteTextures( 1, &textureID );
+    textureID = newTextureID;
+}
+
+void World::initCube()
+{
+    // 0 1 2
+    m_cube.vertices.push_back( -1.0f );    // X
+    m_cube.vertices.push_back( -1.0f );    // Y
+    m_cube.vertices.push_back( 1.0f );      // Z
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 3 4 5
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 6 7 8
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 9 10 11
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 12 13 14
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // 15 16 17
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // 18 19 20
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // 21 22 23
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // 24 25 26
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 27 28 29
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    // 30 31 32
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // 33 34 35
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    m_cube.vertices.push_back( -1.0f );
+    m_cube.vertices.push_back( 1.0f );
+    m_cube.vertices.push_back( -1.0f );
+
+    // Indices
+    m_cube.indices.push_back( 0 );
+    m_cube.indices.push_back( 1 );
+    m_cube.indices.push_back( 2 );
+
+    m_cube.indices.push_back( 3 );
+    m_cube.indices.push_back( 4 );
+    m_cube.indices.push_back( 5 );
+
+    m_cube.indices.push_back( 6 );
+    m_cube.indices.push_back( 7 );
+    m_cube.indices.push_back( 8 );
+
+    m_cube.indices.push_back( 9 );
+    m_cube.indices.push_back( 10 );
+    m_cube.indices.push_back( 11 );
+
+    m_cube.indices.push_back( 12 );
+    m_cube.indices.push_back( 13 );
+    m_cube.indices.push_back( 14 );
+
+    m_cube.indices.push_back( 15 );
+    m_cube.indices.push_back( 16 );
+    m_cube.indices.push_back( 17 );
+
+    m_cube.indices.push_back( 18 );
+    m_cube.indices.push_back( 19 );
+    m_cube.indices.push_back( 20 );
+
+    m_cube.indices.push_back( 21 );
+    m_cube.indices.push_back( 22 );
+    m_cube.indices.push_back( 23 );
+
+    m_cube.indices.push_back( 24 );
+    m_cube.indices.push_back( 25 );
+    m_cube.indices.push_back( 26 );
+
+    m_cube.indices.push_back( 27 );
+    m_cube.indices.push_back( 28 );
+    m_cube.indices.push_back( 29 );
+
+    m_cube.indices.push_back( 30 );
+    m_cube.indices.push_back( 31 );
+    m_cube.indices.push_back( 32 );
+
+    m_cube.indices.push_back( 33 );
+    m_cube.indices.push_back( 34 );
+    m_cube.indices.push_back( 35 );
+
+    // Normals: front, right, back, left, bottom, top, six vertices each
+    static const GLfloat faceNormals[6][3] = { {  0.0f,  0.0f,  1.0f },
+                                               {  1.0f,  0.0f,  0.0f },
+                                               {  0.0f,  0.0f, -1.0f },
+                                               { -1.0f,  0.0f,  0.0f },
+                                               {  0.0f, -1.0f,  0.0f },
+                                               {  0.0f,  1.0f,  0.0f } };
+    for ( size_t face = 0; face < 6; ++face ) {
+        for ( size_t i = 0; i < 6; ++i ) {
+            m_cube.normals.push_back( faceNormals[face][0] );
+            m_cube.normals.push_back( faceNormals[face][1] );
+            m_cube.normals.push_back( faceNormals[face][2] );
+        }
+    }
+
+    // Texture
+    for ( size_t i = 0; i < 6; ++i ) {
+        m_cube.textures.push_back( 0.0f );
+        m_cube.textures.push_back( 0.0f );
+
+        m_cube.textures.push_back( 1.0f );
+        m_cube.textures.push_back( 0.0f );
+
+        m_cube.textures.push_back( 0.0f );
+        m_cube.textures.push_back( 1.0f );
+
+        m_cube.textures.push_back( 1.0f );
+        m_cube.textures.push_back( 0.0f );
+
+        m_cube.textures.push_back( 1.0f );
+        m_cube.textures.push_back( 1.0f );
+
+        m_cube.textures.push_back( 0.0f );
+        m_cube.textures.push_back( 1.0f );
+    }
+}
+
+void World::genTexture()
+{
+    LoadedAsset ground;
+    LoadedAsset cube;
+    if ( !Assets::load( GROUND_TEXTURE, m_assets.path( GROUND_TEXTURE ), ground ) )
+        qWarning() << "Cannot read" << GROUND_TEXTURE;
+    if ( !Assets::load( CUBE_TEXTURE, m_assets.path( CUBE_TEXTURE ), cube ) )
+        qWarning() << "Cannot read" << CUBE_TEXTURE;
+
+    // Terrain tiles repeat the snow texture once per grid cell
+    m_groundTextureID = uploadTexture( ground.image, GL_REPEAT );
+    m_cubeTextureID = uploadTexture( cube.image, GL_CLAMP_TO_EDGE );
+
+    m_assets.watch( GROUND_TEXTURE );
+    m_assets.watch( CUBE_TEXTURE );
+
+    //    // Ground
+    //    QImage groundImage;
+    //    groundImage.load( QString(":/textures/Snow.jpg") );
+    //    groundImage = QGLWidget::convertToGLFormat( groundImage );
+
+    //    GLuint textureIDs[2];
+
+    //    glGenTextures( 2, textureIDs );
+
+    //    m_groundTextureID = textureIDs[0];
+    //    m_cubeTextureID = textureIDs[1];
+
+    //    glBindTexture( GL_TEXTURE_2D, m_groundTextureID );
+
+    //    glTexImage2D( GL_TEXTURE_2D, 0, 3,
+    //                  ( GLsizei ) groundImage.width(),
+    //                  ( GLsizei ) groundImage.height(), 0,
+    //                  GL_RGBA, GL_UNSIGNED_BYTE, groundImage.bits() );
+
+    //    QImage cubeImage;
+    //    cubeImage.load( QString(":/textures/picture1.jpg") );
+    //    cubeImage = QGLWidget::convertToGLFormat( cubeImage );
+
+    //    glBindTexture( GL_TEXTURE_2D, m_cubeTextureID );
+
+    //    glTexImage2D( GL_TEXTURE_2D, 0, 3,
+    //                  ( GLsizei ) cubeImage.width(),
+    //                  ( GLsizei ) cubeImage.height(), 0,
+    //                  GL_RGBA, GL_UNSIGNED_BYTE, cubeImage.bits() );
+
+    //    // дополнительные параметры текстурного объекта
+    //    // задаём линейную фильтрацию вблизи:
+    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    //    // задаём линейную фильтрацию вдали:
+    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    //    // задаём: при фильтрации игнорируются тексели, выходящие за границу текстуры для s координаты
+    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    //    // задаём: при фильтрации игнорируются тексели, выходящие за границу текстуры для t координаты
+    //    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    //    // задаём: цвет текселя полностью замещает цвет фрагмента фигуры
+    //    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+}
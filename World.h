@@ -0,0 +1,103 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <deque>
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QGLWidget>
+#include "Cube.h"
+#include "Tree.h"
+#include "Snow.h"
+#include "Terrain.h"
+#include "Assets.h"
+#include "Replay.h"
+
+class Scene;
+
+///////////////////////////////////////////////////////
+// Everything the views of one forest share: meshes,
+// textures, trees, terrain and snow. The simulation is
+// stepped once per tick for all views, then each view
+// is repainted with its own camera. Textures live in
+// the views' shared GL context and are created by the
+// first view to initialise.
+class World : public QObject
+{
+    Q_OBJECT
+public:
+    explicit World( QObject *parent = 0 );
+    ~World();
+
+    void addView( Scene *view );
+    void removeView( Scene *view );
+    size_t views() const { return m_views.size(); }
+
+    // Position of view among the views, views() if it is not one
+    size_t viewIndex( const Scene *view ) const;
+
+    // Called from every view's initializeGL, creates the shared
+    // GL resources the first time
+    void initializeGL();
+
+    const Cube &cube() const { return m_cube; }
+    const std::vector<Tree> &trees() const { return m_trees; }
+    Terrain &terrain() { return m_terrain; }
+    Snow &snow() { return m_snow; }
+    GLuint groundTextureID() const { return m_groundTextureID; }
+    GLuint cubeTextureID() const { return m_cubeTextureID; }
+    GLfloat treeRotation() const { return m_yRot; }
+
+    // Log every tick and key press until the world is destroyed
+    bool record( const QString &path, const QSize &windowSize );
+    void recordKey( Scene *view, int key );
+
+    // Step through a log as fast as possible instead of on the
+    // timer, ignoring the keyboard. Headless replays only cull,
+    // they do not draw. replayFinished() is emitted at the end.
+    bool replay( const QString &path, bool headless );
+    const ReplayPlayer &replayLog() const { return m_player; }
+    bool isReplaying() const { return m_player.isOpen(); }
+    bool isHeadless() const { return m_headless; }
+
+signals:
+    void replayFinished();
+
+private slots:
+    void slotUpdate();
+
+private:
+    void initCube();
+    void initTrees();
+    void setTrees( const LoadedAsset &scene );
+    void genTexture();
+    void applyLoadedAssets();
+    GLuint uploadTexture( const QImage &image, GLint wrap );
+    void replaceTexture( GLuint &textureID, const QImage &image, GLint wrap );
+    bool replayEvents( GLfloat &dt );
+    std::vector< std::pair<float, float> > cameraPositions() const;
+
+private:
+    std::vector<Scene*> m_views;
+    GLuint m_groundTextureID;
+    GLuint m_cubeTextureID;
+    Terrain m_terrain;
+    Cube m_cube;
+    Snow m_snow;
+    std::vector<Tree> m_trees;
+    Assets m_assets;
+    std::deque<LoadedAsset> m_pendingAssets;   // Loaded, waiting for upload
+    bool m_glInitialized;
+    bool m_generateMipmaps;
+    QTimer m_timer;
+    QElapsedTimer m_frameTimer;
+    GLfloat m_yRot;
+    ReplayRecorder m_recorder;
+    ReplayPlayer m_player;
+    ReplayStats m_replayStats;
+    bool m_headless;
+    bool m_replayStarted;
+};
+
+#endif // WORLD_H
@@ -1,11 +1,66 @@
 #include "Dialog.h"
+#include "World.h"
 #include <QApplication>
+#include <QStringList>
+#include <QGLFormat>
+#include <QLayout>
+
+// Value following option on the command line, or an empty string
+static QString option(const QStringList &arguments, const char *name)
+{
+    int index = arguments.indexOf(name);
+    if (index >= 0 && index + 1 < arguments.size())
+        return arguments.at(index + 1);
+    return QString();
+}
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    QStringList arguments = a.arguments();
+
+    // --views N shows the forest from N cameras at once
+    int views = 1;
+    if (!option(arguments, "--views").isEmpty())
+        views = qMax(1, option(arguments, "--views").toInt());
+
+    // --record FILE logs every tick and key press of the session.
+    // --replay FILE plays such a log back as fast as possible and
+    // prints frame time statistics; add --headless to skip drawing.
+    QString recordPath = option(arguments, "--record");
+    QString replayPath = option(arguments, "--replay");
+    bool headless = arguments.contains("--headless");
+
+    // Replays must not wait for the display's refresh
+    if (!replayPath.isEmpty()) {
+        QGLFormat format = QGLFormat::defaultFormat();
+        format.setSwapInterval(0);
+        QGLFormat::setDefaultFormat(format);
+    }
+
     Dialog w;
-    w.show();
+    World &world = w.world();
+
+    if (!replayPath.isEmpty()) {
+        if (!world.replay(replayPath, headless))
+            return 1;
+        QObject::connect(&world, SIGNAL(replayFinished()), &a, SLOT(quit()));
+
+        views = world.replayLog().views();
+        if (world.replayLog().windowSize().isValid())
+            w.resize(world.replayLog().windowSize());
+    }
+
+    w.setViewCount(views);
+
+    if (!replayPath.isEmpty() && headless) {
+        w.layout()->activate();
+    } else {
+        w.show();
+    }
+
+    if (!recordPath.isEmpty() && replayPath.isEmpty() && !world.record(recordPath, w.size()))
+        return 1;
 
     return a.exec();
 }